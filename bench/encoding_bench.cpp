@@ -0,0 +1,55 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+
+#include "vm.h"
+
+/*
+ Compares the two value representations ('Nan_Box' and 'Int_Box', see 'nan_box.h') by running '.vm' programs
+ (the examples, assembled with 'vasma') several times with each one.
+ The results go to stderr, redirect stdout to hide the output of the programs.
+ */
+
+#define REPETITIONS 2000
+
+// average microseconds per run of 'p'
+template <typename Box>
+static double run(const std::shared_ptr<const Image> &image) {
+    Basic_Vm<Box> vm(image);
+    vm.execute_program(); // warm up
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < REPETITIONS; i++)
+        vm.execute_program();
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / REPETITIONS;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <file.vm>..." << std::endl;
+        return 1;
+    }
+
+    std::cerr << std::left << std::setw(24) << "program" << std::right << std::setw(14) << "nan" << std::setw(14) << "int" << std::setw(10) << "int/nan" << std::endl;
+    for (int i = 1; i < argc; i++) {
+        std::string error;
+        const std::shared_ptr<const Image> image = Image::load(argv[i], error);
+        if (!image) {
+            std::cerr << "ERROR: " << error << "." << std::endl;
+            return 1;
+        }
+
+        const double nan_us = run<Nan_Box>(image);
+        const double int_us = run<Int_Box>(image);
+
+        const std::string name = std::string(argv[i]).substr(std::string(argv[i]).find_last_of("/\\") + 1);
+        std::cerr << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(11) << nan_us << " us" << std::setw(11) << int_us << " us"
+                  << std::setw(9) << std::setprecision(2) << int_us / nan_us << "x" << std::endl;
+    }
+
+    return 0;
+}
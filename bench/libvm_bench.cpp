@@ -0,0 +1,77 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+
+#include "libvm.h"
+#include "vm.h"
+#include "bytecode.h"
+
+/*
+ Measures the cost of one call into the vm through the C API of libvm: pushing the arguments, running a tiny program
+ (a few instructions, so the time is mostly the call itself: resetting the vm, entering the interpreter loop and leaving it)
+ and reading the result. The same programs are also run with 'Vm::run' directly.
+ */
+
+#define CALLS 1000000
+
+// the contents of a '.vm' file with no static memory
+static std::vector<uint8_t> vm_file(const std::vector<Inst> &insts) {
+    return encode_program(Program(insts.data(), insts.size()));
+}
+
+// average nanoseconds per call
+template <typename Call>
+static double measure(Call call) {
+    for (size_t i = 0; i < CALLS / 100; i++) // warm up
+        call(i);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < CALLS; i++)
+        call(i);
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / CALLS;
+}
+
+int main() {
+    const Nan_Box zero(static_cast<int64_t>(0));
+    const std::vector<uint8_t> empty = vm_file({{Inst_Type::INST_NOP, zero}});
+    const std::vector<uint8_t> add = vm_file({{Inst_Type::INST_ADD, zero}});
+
+    vm_image *const empty_image = vm_image_load(empty.data(), empty.size());
+    vm_image *const add_image = vm_image_load(add.data(), add.size());
+    vm_instance *const empty_vm = vm_create(empty_image, 0);
+    vm_instance *const add_vm = vm_create(add_image, 0);
+
+    int64_t check = 0;
+    const double c_empty = measure([&](size_t) {
+        vm_run(empty_vm);
+    });
+    const double c_add = measure([&](const size_t i) {
+        vm_clear_arguments(add_vm);
+        vm_push_int(add_vm, static_cast<int64_t>(i));
+        vm_push_int(add_vm, 1);
+        vm_run(add_vm);
+        check += vm_result_int(add_vm, 0);
+    });
+
+    Vm vm(std::make_shared<const Image>(Program(std::vector<Inst> {{Inst_Type::INST_ADD, zero}}.data(), 1)));
+    const double cpp_add = measure([&](const size_t i) {
+        vm.get_arguments().assign({Nan_Box(static_cast<int64_t>(i)), Nan_Box(static_cast<int64_t>(1))});
+        vm.run();
+        check += vm.get_results().back().as_int();
+    });
+
+    std::cerr << std::fixed << std::setprecision(1);
+    std::cerr << "vm_run, empty program:       " << std::setw(8) << c_empty << " ns/call" << std::endl;
+    std::cerr << "vm_run, 2 arguments + add:   " << std::setw(8) << c_add << " ns/call" << std::endl;
+    std::cerr << "Vm::run, 2 arguments + add:  " << std::setw(8) << cpp_add << " ns/call" << std::endl;
+    std::cerr << "(checksum " << check << ")" << std::endl;
+
+    vm_destroy(add_vm);
+    vm_destroy(empty_vm);
+    vm_image_free(add_image);
+    vm_image_free(empty_image);
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "nan_box.h"
+
+/*
+ Compares the inline Nan_Box operators with the previous out-of-line implementation ('legacy' below, the same code
+ that used to live in 'nan_box.cpp': 'get_type' with 'isnan' and a type pun, boxing through a quiet nan).
+ Each operator runs in a dependency chain (the result is the lhs of the next iteration) so it cannot be hoisted or vectorized.
+ */
+
+#define ITERATIONS 50000000ULL
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define NOINLINE __attribute__((noinline))
+#else
+    #define NOINLINE __declspec(noinline)
+#endif
+
+// hides the value from the optimizer (so the loop cannot be replaced by a closed form)
+static inline void opaque(Nan_Box &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    uint64_t bits = value.bits();
+    asm volatile("" : "+r"(bits));
+    value = Nan_Box(std::bit_cast<double>(bits));
+#else
+    volatile double copy = value.as_double();
+    value = Nan_Box(copy);
+#endif
+}
+
+namespace legacy {
+    constexpr uint64_t TYPE_MASK = ((1ULL << 3ULL) - 1ULL) << 48ULL;
+    constexpr uint64_t VALUE_MASK = (1ULL << 48ULL) - 1ULL;
+
+    NOINLINE Nan_Type get_type(const Nan_Box &value) {
+        if (!std::isnan(value.as_double()))
+            return Nan_Type::DOUBLE;
+
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return (Nan_Type) ((bits & TYPE_MASK) >> 48ULL);
+    }
+
+    NOINLINE int64_t as_int(const Nan_Box &value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint64_t new_value = bits & VALUE_MASK;
+
+        if (get_type(value) == Nan_Type::INT && (new_value >> 47ULL) == 1)
+            new_value |= 0xFFFF000000000000;
+
+        return (int64_t) new_value;
+    }
+
+    NOINLINE void box_int(Nan_Box &value, const int64_t int_value) {
+        double nan = std::numeric_limits<double>::quiet_NaN();
+        uint64_t bits;
+        std::memcpy(&bits, &nan, sizeof(bits));
+        bits = (bits & ~TYPE_MASK) | ((uint64_t)Nan_Type::INT << 48ULL);
+        bits |= (uint64_t)int_value & VALUE_MASK;
+        value = Nan_Box(std::bit_cast<double>(bits));
+    }
+
+    // only the int/int and double/double cases (the ones measured)
+    #define LEGACY_OP(name, op)                                                      \
+        NOINLINE void name(Nan_Box &lhs, Nan_Box &rhs) {                             \
+            const Nan_Type type = get_type(lhs);                                     \
+            const Nan_Type rhs_type = get_type(rhs);                                 \
+                                                                                     \
+            if (type == Nan_Type::DOUBLE && rhs_type == Nan_Type::DOUBLE)            \
+                lhs = Nan_Box(lhs.as_double() op rhs.as_double());                   \
+            else if (type == Nan_Type::INT && rhs_type == Nan_Type::INT)             \
+                box_int(lhs, (int64_t)((uint64_t)as_int(lhs) op (uint64_t)as_int(rhs))); \
+        }
+
+    #define LEGACY_INT_OP(name, op)                                                  \
+        NOINLINE void name(Nan_Box &lhs, Nan_Box &rhs) {                             \
+            if (get_type(lhs) == Nan_Type::INT && get_type(rhs) == Nan_Type::INT)    \
+                box_int(lhs, as_int(lhs) op as_int(rhs));                            \
+        }
+
+    LEGACY_OP(add, +)
+    LEGACY_OP(sub, -)
+    LEGACY_OP(mul, *)
+    LEGACY_INT_OP(mod, %)
+    LEGACY_INT_OP(shl, <<)
+    LEGACY_INT_OP(sar, >>)
+    LEGACY_INT_OP(band, &)
+    LEGACY_INT_OP(bor, |)
+    LEGACY_INT_OP(bxor, ^)
+
+    NOINLINE void div(Nan_Box &lhs, Nan_Box &rhs) {
+        if (get_type(lhs) == Nan_Type::DOUBLE && get_type(rhs) == Nan_Type::DOUBLE && rhs.as_double() != 0.0)
+            lhs = Nan_Box(lhs.as_double() / rhs.as_double());
+    }
+
+    NOINLINE void bnot(Nan_Box &lhs, Nan_Box &) {
+        if (get_type(lhs) == Nan_Type::INT)
+            box_int(lhs, ~as_int(lhs));
+    }
+
+    NOINLINE void equ(Nan_Box &lhs, Nan_Box &rhs) {
+        const Nan_Type type = get_type(lhs);
+        bool equal = false;
+        if (type == get_type(rhs))
+            equal = type == Nan_Type::DOUBLE ? lhs.as_double() == rhs.as_double() : as_int(lhs) == as_int(rhs);
+
+        box_int(lhs, equal);
+    }
+}
+
+// nanoseconds per call of 'op(lhs, rhs)'
+template <typename Op>
+static double run(Op op, Nan_Box lhs, Nan_Box rhs) {
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ITERATIONS; i++) {
+        op(lhs, rhs);
+        opaque(lhs);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    // keep the result alive
+    volatile double sink = lhs.as_double();
+    (void) sink;
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(ITERATIONS);
+}
+
+template <typename New_Op, typename Legacy_Op>
+static void compare(const char *name, New_Op new_op, Legacy_Op legacy_op, const Nan_Box lhs, const Nan_Box rhs) {
+    const double new_ns = run(new_op, lhs, rhs);
+    const double legacy_ns = run(legacy_op, lhs, rhs);
+
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << legacy_ns << " ns" << std::setw(10) << new_ns << " ns"
+              << std::setw(9) << std::setprecision(2) << legacy_ns / new_ns << "x" << std::endl;
+}
+
+int main() {
+    const Nan_Box i1(static_cast<int64_t>(1));
+    const Nan_Box i3(static_cast<int64_t>(3));
+    const Nan_Box i7(static_cast<int64_t>(7));
+    const Nan_Box i_big(static_cast<int64_t>(123456789));
+    const Nan_Box d1(1.0000001);
+    const Nan_Box d2(0.5);
+
+    std::cout << std::left << std::setw(12) << "operator" << std::right << std::setw(13) << "legacy" << std::setw(13) << "inline" << std::setw(10) << "speedup" << std::endl;
+
+    compare("add int",    [](Nan_Box &a, Nan_Box &b) { a += b; }, legacy::add, i1, i3);
+    compare("add double", [](Nan_Box &a, Nan_Box &b) { a += b; }, legacy::add, d1, d2);
+    compare("sub int",    [](Nan_Box &a, Nan_Box &b) { a -= b; }, legacy::sub, i1, i3);
+    compare("sub double", [](Nan_Box &a, Nan_Box &b) { a -= b; }, legacy::sub, d1, d2);
+    compare("mul int",    [](Nan_Box &a, Nan_Box &b) { a *= b; }, legacy::mul, i1, i3);
+    compare("mul double", [](Nan_Box &a, Nan_Box &b) { a *= b; }, legacy::mul, d1, d1);
+    compare("div double", [](Nan_Box &a, Nan_Box &b) { a /= b; }, legacy::div, d1, d1);
+    compare("mod int",    [](Nan_Box &a, Nan_Box &b) { a %= b; }, legacy::mod, i_big, i7);
+    compare("shl int",    [](Nan_Box &a, Nan_Box &b) { a <<= b; }, legacy::shl, i1, i1);
+    compare("sar int",    [](Nan_Box &a, Nan_Box &b) { a >>= b; }, legacy::sar, i_big, i1);
+    compare("and int",    [](Nan_Box &a, Nan_Box &b) { a &= b; }, legacy::band, i_big, i7);
+    compare("or int",     [](Nan_Box &a, Nan_Box &b) { a |= b; }, legacy::bor, i1, i7);
+    compare("xor int",    [](Nan_Box &a, Nan_Box &b) { a ^= b; }, legacy::bxor, i1, i7);
+    compare("not int",    [](Nan_Box &a, Nan_Box &) { ~a; }, legacy::bnot, i1, i1);
+    compare("equ int",    [](Nan_Box &a, Nan_Box &b) { a.box_int(a == b); }, legacy::equ, i1, i1);
+    compare("equ double", [](Nan_Box &a, Nan_Box &b) { a.box_int(a == b); }, legacy::equ, d1, d1);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "vector_kernels.h"
+
+/*
+ Compares the vector kernels of every instruction set supported by the cpu with the scalar ones ('vme' always uses the best one).
+ The element-wise results must be equal to the scalar results, the double reductions can differ in the last bits (different order of the sums).
+ The arrays start 8 bytes after an aligned addr, like most arrays in the vm memory.
+ */
+
+#define ELEMENTS 4099 // not a multiple of any vector width
+#define REPETITIONS 20000
+
+static std::vector<uint8_t> a_mem(ELEMENTS * VECTOR_ELEMENT_SIZE + 8), b_mem(a_mem.size()), dst_mem(a_mem.size()), ref_mem(a_mem.size());
+static uint8_t *const a = a_mem.data() + 8, *const b = b_mem.data() + 8, *const dst = dst_mem.data() + 8, *const ref = ref_mem.data() + 8;
+
+// average nanoseconds per call of 'f'
+template <typename F>
+static double time_ns(F f) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < REPETITIONS; i++)
+        f();
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / REPETITIONS;
+}
+
+template <typename T>
+static void fill(uint8_t *mem, const T first, const T step) {
+    for (size_t i = 0; i < ELEMENTS; i++) {
+        const T value = static_cast<T>(first + step * static_cast<T>(i % 1000));
+        std::memcpy(mem + i * VECTOR_ELEMENT_SIZE, &value, sizeof(T));
+    }
+}
+
+template <typename T>
+static bool bench(const char *type, const Vector_Ops<T> &ops, const Vector_Ops<T> &scalar) {
+    bool ok = true;
+    const size_t bytes = ELEMENTS * VECTOR_ELEMENT_SIZE;
+    volatile T sink;
+
+    // element-wise: compared with the scalar kernel
+    const auto element_wise = [&](const char *name, auto run, auto run_scalar) {
+        run_scalar(ref);
+        run(dst);
+        const bool equal = std::memcmp(dst, ref, bytes) == 0;
+        ok = ok && equal;
+        std::cerr << "    " << type << " " << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << time_ns([&] { run(dst); }) << " ns" << (equal ? "" : "   MISMATCH") << std::endl;
+    };
+
+    element_wise("vadd",   [&](uint8_t *d) { ops.add(d, a, b, ELEMENTS); }, [&](uint8_t *d) { scalar.add(d, a, b, ELEMENTS); });
+    element_wise("vmul",   [&](uint8_t *d) { ops.mul(d, a, b, ELEMENTS); }, [&](uint8_t *d) { scalar.mul(d, a, b, ELEMENTS); });
+    element_wise("vdiv",   [&](uint8_t *d) { ops.div(d, a, b, ELEMENTS); }, [&](uint8_t *d) { scalar.div(d, a, b, ELEMENTS); });
+    element_wise("vscale", [&](uint8_t *d) { ops.scale(d, a, T(3), ELEMENTS); }, [&](uint8_t *d) { scalar.scale(d, a, T(3), ELEMENTS); });
+    element_wise("vfma",   [&](uint8_t *d) { std::memset(d, 0, bytes); ops.fma(d, a, b, ELEMENTS); },
+                           [&](uint8_t *d) { std::memset(d, 0, bytes); scalar.fma(d, a, b, ELEMENTS); });
+
+    // reductions: the result of the last call is printed
+    const auto reduction = [&](const char *name, auto run) {
+        T result = 0;
+        const double ns = time_ns([&] { result = run(); sink = result; });
+        std::cerr << "    " << type << " " << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << ns << " ns   = " << std::defaultfloat << result << std::endl;
+    };
+
+    reduction("vdot", [&] { return ops.dot(a, b, ELEMENTS); });
+    reduction("vsum", [&] { return ops.sum(a, ELEMENTS); });
+    reduction("vmax", [&] { return ops.max(a, ELEMENTS); });
+    (void) sink;
+    return ok;
+}
+
+int main() {
+    const Vector_Kernels &scalar = vector_kernels(VECTOR_ISA_SCALAR);
+    bool ok = true;
+
+    std::cerr << ELEMENTS << " elements, selected: " << vector_kernels().name << std::endl;
+    for (int isa = 0; isa < VECTOR_ISA_COUNT; isa++) {
+        if (!vector_isa_supported(static_cast<Vector_Isa>(isa)))
+            continue;
+
+        const Vector_Kernels &kernels = vector_kernels(static_cast<Vector_Isa>(isa));
+        std::cerr << kernels.name << ":" << std::endl;
+
+        fill<double>(a, 0.25, 1.5);
+        fill<double>(b, 1.0, 0.75);
+        ok = bench("f64", kernels.f64, scalar.f64) && ok;
+
+        fill<int64_t>(a, -500, 3);
+        fill<int64_t>(b, 1, 2);
+        ok = bench("i64", kernels.i64, scalar.i64) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
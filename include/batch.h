@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+
+#include "vm.h"
+
+// what one run of the program did with one input record
+typedef struct {
+    std::string out;          // captured stdout
+    std::string err;          // captured stderr
+    Exception_Type exception; // 'EXCEPTION_OK' if the program ended normally
+} Batch_Result;
+
+/*
+ Runs one program over many independent input records (each record is the stdin of one run, see 'Vm::set_input') on a pool of threads.
+ The workers share the image and each one has its own vm, reused for all of its records: 'Vm::run' resets the stack, the memory
+ and the heap, and the quickened code is kept between runs. The output of every run is captured and handed to 'emit' in the
+ order of the records, as soon as all the records before it are done.
+
+ The records start split in one contiguous range per worker. A worker takes records from the front of its own queue and, when it
+ is empty, steals from the back of the queue of another worker, so a few slow records do not leave the other threads idle.
+ */
+template <typename Box>
+class Batch {
+public:
+    typedef std::function<void(Basic_Vm<Box> &vm)> Setup; // called once for the vm of each worker (fuel, timeout, ...)
+    typedef std::function<void(size_t record, const Batch_Result &result)> Emit;
+
+    Batch(std::shared_ptr<const Image> image, size_t workers, size_t stack_cap, Dispatch_Mode mode, Setup setup);
+    ~Batch() {}
+
+    // returns the number of records that raised an exception, throws 'std::bad_alloc' if the vms cannot be reserved
+    size_t run(const std::vector<std::string_view> &records, const Emit &emit);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> records;
+    };
+
+    bool next_record(size_t worker, size_t &record);
+
+    std::shared_ptr<const Image> image;
+    size_t workers;
+    size_t stack_cap;
+    Dispatch_Mode mode;
+    Setup setup;
+
+    std::unique_ptr<Queue[]> queues; // one per worker
+};
+
+// instantiated in 'batch.cpp'
+extern template class Batch<Nan_Box>;
+extern template class Batch<Int_Box>;
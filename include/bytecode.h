@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "program.h"
+
+#define BYTECODE_MAGIC "VMBC"
+#define BYTECODE_VERSION 2 // 2: the bss section
+
+// ids of the sections (sections with other ids are skipped, so newer writers can add sections)
+typedef enum {
+    SECTION_CODE = 1,  // number of instructions, then the instructions
+    SECTION_CONSTANTS, // operands that do not fit in a small varint (doubles), referenced by index from the code
+    SECTION_DATA,      // the static memory (raw bytes)
+    SECTION_SYMBOLS,   // names of the labels and their addrs (only used by the disassembler)
+    SECTION_BSS        // number of zero bytes after the static memory (varint), they are not stored
+} Section_Id;
+
+// what follows each instruction in the code section
+typedef enum {
+    OPERAND_NONE = 0, // no operand (the instructions without one, and a 0 int)
+    OPERAND_INT,      // zigzag varint
+    OPERAND_ADDR,     // varint
+    OPERAND_CONSTANT  // varint index into the constant pool
+} Operand_Kind;
+
+/*
+ The '.vm' file format, every number is little-endian whatever the machine:
+
+    header:   "VMBC", version (u16), flags (u16, 0), number of sections (u32), 0 (u32)
+    sections: id (u32), 0 (u32), offset in the file (u64), size in bytes (u64) for each section
+    ...       the sections
+    trailer:  checksum of everything before it (u64)
+
+ Each instruction is one byte with the 'Inst_Type' in the low 6 bits and the kind of operand in the high 2 bits ('Operand_Kind'),
+ followed by the operand: a zigzag varint for ints, a varint for addrs (labels) or a varint index into the constant pool.
+ The instructions without operands take a single byte, so most programs are several times smaller than their 'Inst' arrays.
+ */
+std::vector<uint8_t> encode_program(const Program &program);
+bool decode_program(const uint8_t *data, size_t size, Program &program, std::string &error); // 'error' says why the file is not valid
+bool decode_program(const uint8_t *data, size_t size, Program &program, std::span<const uint8_t> &memory, std::string &error); // the static memory is left in 'data' (not copied to 'program.memory')
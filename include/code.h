@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+#include <bit>
+
+#include "inst.h"
+#include "nan_box.h"
+
+// number of times an instruction can be turned back into the generic one before it stops being quickened
+#define MAX_DEQUICKENS 4
+
+// opcodes that only exist in the decoded code (they continue the 'Inst_Type' numbering)
+typedef enum {
+    OP_TRAP = Inst_Type::INST_COUNT, // raises the exception stored in the operand (used for instructions that are known to be invalid)
+
+    // superinstructions (see 'Code::fuse')
+    OP_SWAP_POP,     // swap k / pop
+    OP_PUSH_ADD,     // push v / add
+    OP_DUP_ADD,      // dup k / add
+    OP_DUP_DUP,      // dup a / dup b
+    OP_PUSH_EQU_JIF, // push v / equ / jif addr
+
+    // quickened instructions, specialized for the operand types seen at runtime (see 'Code::quicken')
+    OP_ADD_II,
+    OP_ADD_DD,
+    OP_SUB_II,
+    OP_SUB_DD,
+    OP_MUL_II,
+    OP_MUL_DD,
+    OP_DIV_DD,
+    OP_COUNT
+} Internal_Op;
+
+/*
+ Compact, pre-decoded form of a list of instructions, built once at load time and used by the threaded interpreter loop.
+
+ The opcodes and the operands are kept in two separate arrays (indexed by the instruction addr) so the hot loop only touches
+ one byte per instruction for the dispatch. All the operand decoding and validation that does not depend on the runtime state is done here:
+    - 'push' operands are stored as the raw Nan_Box bits;
+    - jump/call targets are already validated instruction indices;
+    - dup/swap/print/td/ti/tp store the offset from the stack pointer ('index + 1');
+    - invalid operands (negative indices, bad read/write sizes, unknown natives) turn the instruction into an 'OP_TRAP'.
+
+ Two extra instructions are appended after the end of the program:
+    - 'end_addr()':  an 'exit', so falling off the end of the program does not need a bounds check;
+    - 'trap_addr()': an 'OP_TRAP' with 'EXCEPTION_INVALID_JMP_ADDR', the target of every invalid 'jmp'/'call'.
+
+ 'fuse' replaces the first instruction of some common sequences with a superinstruction that executes the whole sequence.
+ The other instructions of the sequence are left untouched, so every addr keeps its meaning (jumps into the middle of a
+ sequence, return addrs and the debugger still work) and the superinstruction can read the operands of the whole sequence.
+ The sequences were chosen with 'vme -p' (see 'Dispatch_Mode::PROFILE') on the examples.
+
+ 'quicken' is called by the threaded loop the first times it runs an arithmetic instruction, and rewrites it in place to a
+ variant specialized for the operand types it saw (most instructions always see the same types). The specialized variant
+ only checks the types (no type dispatch) and calls 'dequicken' to go back to the generic instruction when they do not match.
+ Instructions that keep seeing different types end up staying generic.
+ */
+class Code {
+public:
+    Code() {}
+    Code(const std::vector<Inst> &insts, size_t native_funcs_count);
+
+    inline uint64_t size()      const { return program_size; }
+    inline uint64_t end_addr()  const { return program_size; }
+    inline uint64_t trap_addr() const { return program_size + 1; }
+    inline bool empty() const { return ops.empty(); }
+
+    void fuse();
+    void quicken(uint64_t addr, Nan_Type lhs, Nan_Type rhs);
+    void dequicken(uint64_t addr);
+    inline bool can_quicken(uint64_t addr) const { return dequickens[addr] < MAX_DEQUICKENS; }
+
+    // converts the values of the 'push' instructions (stored as 'Nan_Box') to the representation used by a vm
+    template <typename Box>
+    void reencode() {
+        for (uint64_t addr = 0; addr < program_size; addr++) {
+            if (ops[addr] == Inst_Type::INST_PUSH || ops[addr] == OP_PUSH_ADD || ops[addr] == OP_PUSH_EQU_JIF)
+                operands[addr] = std::bit_cast<int64_t>(Box(std::bit_cast<Nan_Box>(operands[addr])));
+        }
+    }
+
+    std::vector<uint8_t> ops;
+    std::vector<int64_t> operands;
+
+private:
+    uint64_t program_size = 0;
+    std::vector<uint8_t> dequickens; // per instruction
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lexer.h"
+#include "keyword_table.h"
 
 typedef enum {
     ALIAS = 0,
@@ -29,8 +30,8 @@ constexpr static Token_Type dir_acc_tk[][2][2] = {
     }
 };
 
-static const char *dir_type_as_cstr(const Directive_Type& dir) USED_FUNCTION;
-static const char *dir_type_as_cstr(const Directive_Type& dir) {
+static constexpr const char *dir_type_as_cstr(const Directive_Type& dir) USED_FUNCTION;
+static constexpr const char *dir_type_as_cstr(const Directive_Type& dir) {
     switch (dir) {
     case Directive_Type::ALIAS:     return "alias";
     case Directive_Type::INCLUDE:   return "include";
@@ -43,15 +44,10 @@ static const char *dir_type_as_cstr(const Directive_Type& dir) {
     }
 }
 
-static Directive_Type str_as_dir(const std::string &str) USED_FUNCTION;
-static Directive_Type str_as_dir(const std::string &str) {
-    for (int dir_to_check = 0; dir_to_check < Directive_Type::COUNT; dir_to_check++) {
-        // compare the strings
-        if (!str.compare(dir_type_as_cstr((Directive_Type)dir_to_check))) {
-            return (Directive_Type) dir_to_check;
-        }
-    }
+inline constexpr Keyword_Table<Directive_Type::COUNT, 8> dir_keywords([](const size_t dir) { return std::string_view(dir_type_as_cstr((Directive_Type)dir)); });
 
-    // should never happen
-    return Directive_Type::COUNT;
+// returns 'COUNT' if 'str' is not a directive
+static Directive_Type str_as_dir(const std::string_view str) USED_FUNCTION;
+static Directive_Type str_as_dir(const std::string_view str) {
+    return (Directive_Type) dir_keywords.find(str);
 }
@@ -19,7 +19,17 @@ typedef enum {
     EXCEPTION_BITWISE_NON_INT,
     EXCEPTION_MODULO_NON_INT,
     EXCEPTION_INVALID_MEM_ADDR,
-    EXCEPTION_INVALID_READ_WRITE_SIZE
+    EXCEPTION_INVALID_READ_WRITE_SIZE,
+    EXCEPTION_OUT_OF_FUEL,
+    EXCEPTION_INTERRUPTED,
+    EXCEPTION_INVALID_VECTOR_TYPE,
+    EXCEPTION_INVALID_COROUTINE,
+    EXCEPTION_DEADLOCK,
+    EXCEPTION_INVALID_IO_REQUEST,
+    EXCEPTION_INVALID_FD,
+    EXCEPTION_SNAPSHOT_FAILED,
+    EXCEPTION_OUT_OF_MEMORY
 } Exception_Type;
 
-void exception_handler(Exception_Type exception);
+const char *exception_as_cstr(Exception_Type exception);
+void exception_handler(Exception_Type exception); // prints the exception and exits (unless it is 'EXCEPTION_OK' or 'EXCEPTION_EXIT')
@@ -0,0 +1,82 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vm_memory.h"
+
+#define HEAP_ALIGN 16                    // alignment (and granularity) of every block
+#define HEAP_ARENA_SIZE (64 * 1024)      // the heap grows by whole arenas
+#define HEAP_SIZE_CLASSES 9              // 16, 32, 64, ..., 4096 bytes (bigger blocks take whole arenas)
+#define DEFAULT_HEAP_CAP (1ULL << 32)    // max number of bytes in the heap
+
+typedef struct {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t failed_allocations; // over the cap (returned 0)
+    uint64_t invalid_frees;      // not a live block (double free or not an addr from 'allocate')
+    uint64_t live_bytes;         // rounded up to the block size
+    uint64_t peak_live_bytes;
+    uint64_t arenas;
+} Heap_Stats;
+
+/*
+ The heap used by the 'malloc' and 'free' natives, it lives in the (byte addressable) memory of the vm, right after the static memory.
+ The addrs are offsets in that memory, so they are checked like any other addr by 'read' and 'write' and stay valid if the memory moves.
+
+ Small blocks are rounded up to a size class, each arena only has blocks of one class (bump allocated, then reused from
+ the free list of the class). Big blocks take whole arenas. All the bookkeeping is outside of the vm memory, so a program
+ cannot corrupt it by writing to a freed block.
+ */
+class Heap {
+public:
+    Heap(Vm_Memory &memory, size_t cap = DEFAULT_HEAP_CAP); // throws 'std::bad_alloc' if the memory cannot be reserved
+    ~Heap() {}
+
+    // frees every block, the heap starts again after the current end of the memory (call it after restoring the static memory),
+    // returns false if the memory could not grow to the first heap addr
+    bool reset();
+
+    uint64_t allocate(size_t size); // returns 0 when out of memory (0 is never a heap addr)
+    bool release(uint64_t addr);    // returns false if 'addr' is not a live block, 0 is ignored (like 'free(NULL)')
+
+    // the bookkeeping as a list of words (used by the vm snapshots, the blocks themselves are in the memory saved with them)
+    void save(std::vector<uint64_t> &words) const;
+    bool load(const uint64_t *words, size_t count); // call it after restoring the memory, returns false if the words are not valid for it
+
+    inline const Heap_Stats &get_stats() const { return stats; }
+    void dump_stats(std::ostream &os) const;
+
+private:
+    typedef struct {
+        uint8_t  size_class; // 'LARGE_CLASS' for the first arena of a big block and 'CONTINUATION' for the others
+        uint64_t span;       // number of arenas of a big block
+    } Arena;
+
+    constexpr static uint8_t LARGE_CLASS  = HEAP_SIZE_CLASSES;
+    constexpr static uint8_t CONTINUATION = HEAP_SIZE_CLASSES + 1;
+
+    static inline size_t class_size(const uint8_t size_class) { return static_cast<size_t>(HEAP_ALIGN) << size_class; }
+
+    bool new_arenas(uint64_t count, uint8_t size_class, uint64_t &addr);
+    bool is_live(uint64_t addr) const;
+    void set_live(uint64_t addr, bool live);
+
+    Vm_Memory &memory;
+    size_t cap;
+    uint64_t base; // addr of the first arena
+
+    std::vector<Arena> arenas;
+    std::vector<uint64_t> live; // one bit per 'HEAP_ALIGN' bytes, set at the start of each allocated block
+
+    // small blocks
+    std::vector<uint64_t> free_lists[HEAP_SIZE_CLASSES];
+    uint64_t bump[HEAP_SIZE_CLASSES];     // next never used block in the current arena of each class
+    uint64_t bump_end[HEAP_SIZE_CLASSES];
+
+    // big blocks (addr and span of the free runs of arenas)
+    std::vector<std::pair<uint64_t, uint64_t>> free_large;
+
+    Heap_Stats stats;
+};
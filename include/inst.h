@@ -4,6 +4,7 @@
 
 #include "nan_box.h"
 #include "lexer.h"
+#include "keyword_table.h"
 
 typedef int64_t Word;
 typedef enum {
@@ -52,8 +53,31 @@ typedef enum {
     INST_RET,
 
     // memory related instructions
-    INST_READ,
-    INST_WRITE,
+    INST_READ,   // little-endian Int load (8, 16, 32 or 64 bits)
+    INST_WRITE,  // little-endian Int store (8, 16, 32 or 64 bits)
+    INST_READF,  // little-endian Double load (64 bits)
+    INST_WRITEF, // little-endian Double store (64 bits)
+    INST_COPY,    // copies a block of bytes (the blocks can overlap)
+    INST_FILL,    // sets all the bytes of a block to a value
+    INST_COMPARE, // compares 2 blocks of bytes
+
+    // vector instructions (on arrays of Doubles or Ints in memory, see 'Vector_Type')
+    INST_VADD,
+    INST_VSUB,
+    INST_VMUL,
+    INST_VDIV,
+    INST_VFMA,   // multiply-add
+    INST_VSCALE, // multiply by a value
+    INST_VDOT,   // dot product
+    INST_VSUM,
+    INST_VMIN,
+    INST_VMAX,
+
+    // coroutine instructions (see 'Vm::spawn_coroutine')
+    INST_SPAWN, // starts a coroutine at a label, with the top of the stack as its argument
+    INST_YIELD, // lets the other coroutines run
+    INST_JOIN,  // waits for a coroutine to end and gets its result
+    INST_SLEEP, // suspends the coroutine for some milliseconds
 
     // debug/testing instructions
     INST_DUMP_STACK,
@@ -62,6 +86,13 @@ typedef enum {
     INST_COUNT // this is not a valid instruction (used to known how many instructions we have)
 } Inst_Type;
 
+// element type of the vector instructions (the operand), the elements are 8 bytes
+typedef enum {
+    VECTOR_F64 = 0, // Doubles
+    VECTOR_I64,     // Ints (64 bits in memory)
+    VECTOR_TYPE_COUNT
+} Vector_Type;
+
 typedef struct {
     Inst_Type type;
     Nan_Box operand;
@@ -76,8 +107,8 @@ typedef struct {
     #define USED_FUNCTION
 #endif
 
-static const char *inst_type_as_cstr(const Inst_Type& inst) USED_FUNCTION;
-static const char *inst_type_as_cstr(const Inst_Type& inst) {
+static constexpr const char *inst_type_as_cstr(const Inst_Type& inst) USED_FUNCTION;
+static constexpr const char *inst_type_as_cstr(const Inst_Type& inst) {
     switch (inst) {
     case Inst_Type::INST_NOP:         return "nop";
     case Inst_Type::INST_PUSH:        return "push";
@@ -109,6 +140,25 @@ static const char *inst_type_as_cstr(const Inst_Type& inst) {
     case Inst_Type::INST_NOT:         return "not";
     case Inst_Type::INST_READ:        return "read";
     case Inst_Type::INST_WRITE:       return "write";
+    case Inst_Type::INST_READF:       return "readf";
+    case Inst_Type::INST_WRITEF:      return "writef";
+    case Inst_Type::INST_COPY:        return "copy";
+    case Inst_Type::INST_FILL:        return "fill";
+    case Inst_Type::INST_COMPARE:     return "compare";
+    case Inst_Type::INST_VADD:        return "vadd";
+    case Inst_Type::INST_VSUB:        return "vsub";
+    case Inst_Type::INST_VMUL:        return "vmul";
+    case Inst_Type::INST_VDIV:        return "vdiv";
+    case Inst_Type::INST_VFMA:        return "vfma";
+    case Inst_Type::INST_VSCALE:      return "vscale";
+    case Inst_Type::INST_VDOT:        return "vdot";
+    case Inst_Type::INST_VSUM:        return "vsum";
+    case Inst_Type::INST_VMIN:        return "vmin";
+    case Inst_Type::INST_VMAX:        return "vmax";
+    case Inst_Type::INST_SPAWN:       return "spawn";
+    case Inst_Type::INST_YIELD:       return "yield";
+    case Inst_Type::INST_JOIN:        return "join";
+    case Inst_Type::INST_SLEEP:       return "sleep";
     case Inst_Type::INST_TD:          return "td";
     case Inst_Type::INST_TI:          return "ti";
     case Inst_Type::INST_TP:          return "tp";
@@ -119,17 +169,12 @@ static const char *inst_type_as_cstr(const Inst_Type& inst) {
     }
 }
 
-static Inst_Type str_as_inst(const std::string &str) USED_FUNCTION;
-static Inst_Type str_as_inst(const std::string &str) {
-    for (int inst_to_check = 0; inst_to_check < Inst_Type::INST_COUNT; inst_to_check++) {
-        // compare the strings
-        if (!str.compare(inst_type_as_cstr((Inst_Type)inst_to_check))) {
-            return (Inst_Type) inst_to_check;
-        }
-    }
+inline constexpr Keyword_Table<Inst_Type::INST_COUNT, 256> inst_keywords([](const size_t inst) { return std::string_view(inst_type_as_cstr((Inst_Type)inst)); });
 
-    // should never happen
-    return Inst_Type::INST_COUNT;
+// returns 'INST_COUNT' if 'str' is not an instruction
+static Inst_Type str_as_inst(const std::string_view str) USED_FUNCTION;
+static Inst_Type str_as_inst(const std::string_view str) {
+    return (Inst_Type) inst_keywords.find(str);
 }
 
 // TODO: explain this array
@@ -164,6 +209,25 @@ constexpr static Token_Type inst_acc_tk[][3] = {
     {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_RET
     {INTEGER, UNKNOWN, UNKNOWN}, // INST_READ
     {INTEGER, UNKNOWN, UNKNOWN}, // INST_WRITE
+    {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_READF
+    {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_WRITEF
+    {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_COPY
+    {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_FILL
+    {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_COMPARE
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VADD
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VSUB
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VMUL
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VDIV
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VFMA
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VSCALE
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VDOT
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VSUM
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VMIN
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_VMAX
+    {INTEGER, KEYWORD, UNKNOWN}, // INST_SPAWN
+    {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_YIELD
+    {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_JOIN
+    {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_SLEEP
     {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_DUMP_STACK
     {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_DUMP_MEMORY
     {UNKNOWN, UNKNOWN, UNKNOWN}, // INST_HALT
@@ -176,7 +240,7 @@ static inline bool inst_requires_operand(const Inst_Type inst) {
 
 static inline bool inst_operand_might_be_label(const Inst_Type& inst) {
     // instructions with KEYWORD in the table above
-    return inst == INST_JMP || inst == INST_JMP_IF || inst == INST_CALL;
+    return inst == INST_JMP || inst == INST_JMP_IF || inst == INST_CALL || inst == INST_SPAWN;
 }
 
 static inline bool inst_operand_might_be_function(const Inst_Type& inst) {
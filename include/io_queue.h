@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+    #define HAS_IO_URING
+#endif
+
+#define IO_QUEUE_ENTRIES 256 // size of the io_uring submission queue (requests handed to the kernel with one syscall)
+
+typedef enum {
+    IO_READ = 0,
+    IO_WRITE
+} Io_Op;
+
+// how 'Io_Queue::open' opens a file
+typedef enum {
+    IO_MODE_READ = 0,  // read only
+    IO_MODE_WRITE,     // write only (created or truncated)
+    IO_MODE_READ_WRITE // read and write (created if needed)
+} Io_Mode;
+
+/*
+ Files and queued reads/writes of a vm (used by the 'fopen', 'fclose', 'aread', 'awrite', 'submit', 'poll' and 'wait' natives).
+
+ The requests are only queued by 'queue', 'submit' hands all the queued requests to the kernel at once and the program
+ keeps running while they are done. With io_uring (Linux) 'submit' fills the submission ring and makes a single 'io_uring_enter',
+ the completions are taken from the completion ring by 'poll' and 'wait' without any syscall (unless 'wait' has to block).
+ Without io_uring (or when the kernel does not allow it) 'submit' does the requests right away with 'pread'/'pwrite'.
+ The ring is set up when the first file is opened, so the vms that do not use files do not pay for it.
+
+ The data goes through a buffer owned by each request, so the vm memory can move (the heap grows it) while the kernel
+ works on the request: a write copies the data when it is queued, the vm copies the data of a read when it takes the result.
+ The files are handles of this queue (indices in its table of descriptors), so a program only reaches the files it opened.
+ */
+class Io_Queue {
+public:
+    Io_Queue();
+    ~Io_Queue();
+
+    Io_Queue(const Io_Queue &) = delete;
+    Io_Queue &operator=(const Io_Queue &) = delete;
+
+    int64_t open(const std::string &path, Io_Mode mode); // returns the handle, or '-errno'
+    int64_t close(int64_t handle);                       // returns 0, or '-errno' (the requests not submitted yet fail with '-EBADF')
+
+    // returns the id of the request or '-errno' (the data of a write is copied, up to 4 GiB - 1), 'tag' is kept for the caller
+    int64_t queue(Io_Op op, int64_t handle, uint64_t offset, const uint8_t *data, size_t size, uint64_t tag);
+    size_t submit(size_t wait); // returns how many requests were submitted, and waits until at least 'wait' of them are done
+
+    inline bool valid(const uint64_t id) const { return id < requests.size() && requests[id].used; }
+    bool poll(uint64_t id); // true if the request is done (never blocks)
+    void wait(uint64_t id); // blocks until the request is done (submits it if needed)
+
+    // the result of a done request ('read'/'pwrite' style: bytes or '-errno'), its data and its tag
+    inline int64_t result(const uint64_t id) const { return requests[id].result; }
+    inline Io_Op op(const uint64_t id) const { return requests[id].op; }
+    inline const std::vector<uint8_t> &data(const uint64_t id) const { return requests[id].buffer; }
+    inline uint64_t tag(const uint64_t id) const { return requests[id].tag; }
+    void release(uint64_t id); // the id can be reused
+
+    void reset(); // waits for the requests in flight, then forgets every request and closes every file
+    inline bool uses_io_uring() const { return ring_fd >= 0; }
+    inline bool has_open_files() const { return std::any_of(files.begin(), files.end(), [](const int fd) { return fd >= 0; }); }
+
+private:
+    typedef struct {
+        bool used;
+        bool submitted;
+        bool done;
+        Io_Op op;
+        int fd;
+        uint64_t offset;
+        uint64_t tag;
+        int64_t result;
+        std::vector<uint8_t> buffer;
+    } Request;
+
+    void setup_ring(); // when the first file is opened
+    void reap(); // takes the completions from the ring
+    void enter(unsigned min_complete); // submits what is in the ring and waits for 'min_complete' completions (the requests fail if the kernel refuses them)
+
+    std::vector<int> files; // -1 for closed handles
+    std::vector<Request> requests;
+    std::vector<uint64_t> free_ids;
+    std::vector<uint64_t> queued;
+    size_t in_flight;
+
+    // io_uring (ring_fd is -1 when it is not used)
+    bool ring_tried;
+    int ring_fd;
+    void *sq_ring;
+    void *cq_ring;
+    void *sqes;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned sq_entries;
+    unsigned cq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    void *cqes;
+};
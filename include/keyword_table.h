@@ -0,0 +1,72 @@
+#pragma once
+#include <array>
+#include <string_view>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ A perfect hash table of keywords (the names of the instructions and of the directives), built at compile time: the seed
+ of the hash is searched until no two keywords share a slot, so a lookup is one hash, one slot and one comparison
+ instead of a comparison with every keyword. 'Size' (the number of slots) must be a power of two.
+ */
+template <size_t Count, size_t Size>
+class Keyword_Table {
+    static_assert(Size >= Count && (Size & (Size - 1)) == 0, "the size of a keyword table must be a power of two (and fit every keyword)");
+
+public:
+    // 'name(i)' is the keyword with the value 'i'
+    template <typename Name>
+    consteval Keyword_Table(const Name name) : seed(0), slots(), names() {
+        std::array<uint32_t, Count> hashes {};
+        for (size_t i = 0; i < Count; i++) {
+            names[i] = name(i);
+            hashes[i] = hash(names[i]);
+        }
+
+        // only the slots that are used are tracked while searching
+        for (bool collision = true; collision;) {
+            std::array<uint64_t, (Size + 63) / 64> used {};
+            collision = false;
+            seed++;
+            for (size_t i = 0; i < Count && !collision; i++) {
+                const size_t slot = slot_of(hashes[i], seed);
+                collision = (used[slot / 64] >> (slot % 64)) & 1;
+                used[slot / 64] |= 1ULL << (slot % 64);
+            }
+        }
+
+        slots.fill(EMPTY);
+        for (size_t i = 0; i < Count; i++)
+            slots[slot_of(hashes[i], seed)] = static_cast<uint16_t>(i);
+    }
+
+    // the value of 'word' or 'Count' if it is not a keyword
+    constexpr size_t find(const std::string_view word) const {
+        const uint16_t i = slots[slot_of(hash(word), seed)];
+        return i != EMPTY && names[i] == word ? i : Count;
+    }
+
+private:
+    static constexpr uint16_t EMPTY = UINT16_MAX;
+
+    // FNV-1a (the keywords are short)
+    static constexpr uint32_t hash(const std::string_view word) {
+        uint32_t h = 2166136261u;
+        for (const char c: word) {
+            h ^= static_cast<uint8_t>(c);
+            h *= 16777619u;
+        }
+
+        return h;
+    }
+
+    static constexpr size_t slot_of(const uint32_t hash, const uint32_t seed) {
+        uint32_t h = (hash ^ seed) * 0x9e3779b1u;
+        h ^= h >> 15;
+        return h & (Size - 1);
+    }
+
+    uint32_t seed;
+    std::array<uint16_t, Size> slots;
+    std::array<std::string_view, Count> names;
+};
@@ -1,7 +1,8 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
-#include <functional>
+#include <stdint.h>
 
 typedef enum {
     KEYWORD = 0,
@@ -16,15 +17,20 @@ typedef enum {
 
 typedef struct {
     Token_Type type;
-    std::string value;
+    std::string_view value; // in the mapped source file or in the string arena (see 'Lexer::store'), valid until the program ends
 
-    std::string file_path;
+    uint32_t file_id; // see 'Lexer::file_path'
     size_t line_number;
     size_t line_offset;
 
     bool broken; // true when we know what the token is supposed to be but it's not well formatted
 } Token;
 
+/*
+ The source file is mapped (see 'Mapped_File') and the tokens point into it, so lexing does not copy the words.
+ The mapped files and the strings that are not in them (string literals with escaped chars) are kept until the program
+ ends, as the tokens of an included file are still used (the aliases) after its lexer is gone.
+ */
 class Lexer {
 public:
     Lexer(const char *path, bool check_for_errors = true) : path(path), check_for_errors(check_for_errors) {}
@@ -34,13 +40,16 @@ public:
 
     std::vector<Token> &tokenize();
 
+    static std::string_view file_path(uint32_t file_id);
+    static std::string_view store(std::string str); // keeps 'str' until the program ends
+
 private:
-    std::string read_while(const std::function<bool(char)> &predicate);
-    std::string read_string(bool &broken);
+    template <typename Predicate> std::string_view read_while(Predicate predicate);
+    std::string_view read_string(bool &broken);
     void get_errors();
 
     const char *path;
-    std::string line;
+    std::string_view line;
     size_t pos;
 
     std::vector<Token> tokens;
@@ -0,0 +1,87 @@
+#ifndef LIBVM_H
+#define LIBVM_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ C API of libvm, to embed the vm in other programs (the vme executable is built on the same library).
+
+ An image is a loaded program (the contents of a '.vm' file), it never changes so any number of vms can share it, on any thread.
+ A vm runs one image, it can be run any number of times (each run resets the stack, the memory and the heap in place,
+ without reallocating them, and the quickened code is kept between runs). A vm must only be used by one thread at a time,
+ except for 'vm_interrupt'.
+
+ The arguments are pushed on the stack at the start of every run (the first one is the deepest) and the results are the
+ values left on the stack when the program ends (index 0 is the top). The exceptions are returned by 'vm_run' (0 is no
+ exception), including the failing natives (an invalid file descriptor, a snapshot that cannot be saved) and a memory that
+ cannot be reserved, and the functions report their failures with their return values instead of exiting the process.
+ The library installs no signal handlers: the stack overflows are checked (the checks are only skipped for the programs
+ whose stack height was proved to fit, see 'vme -v').
+ */
+
+#define VM_OK 0
+
+typedef enum {
+    VM_VALUE_DOUBLE = 0,
+    VM_VALUE_INT,
+    VM_VALUE_PTR, // an addr in the memory of the vm (see 'vm_memory')
+    VM_VALUE_EXCEPTION
+} vm_value_type;
+
+typedef struct vm_image vm_image;
+typedef struct vm_snapshot vm_snapshot;
+typedef struct vm_instance vm_instance;
+
+// images (NULL if the program is not valid or cannot be read), the vms keep their image alive after 'vm_image_free'
+vm_image *vm_image_load(const void *data, size_t size);
+vm_image *vm_image_load_file(const char *path);
+void vm_image_free(vm_image *image);
+
+// snapshots taken by 'vme -S' (NULL if the file is not a snapshot), the vms keep their snapshot alive after 'vm_snapshot_free'
+vm_snapshot *vm_snapshot_load_file(const char *path);
+void vm_snapshot_free(vm_snapshot *snapshot);
+
+// 'stack_cap' is the max number of values in the stack (0 for the default), NULL if the stack or the memory cannot be reserved
+vm_instance *vm_create(const vm_image *image, size_t stack_cap);
+void vm_destroy(vm_instance *vm);
+
+// every run starts from the snapshot (NULL to start from the program again), returns 0 if it was not taken with the same program
+// (or if its memory cannot be reserved)
+int vm_set_snapshot(vm_instance *vm, const vm_snapshot *snapshot);
+
+// execution limits for each run (0 means no limit)
+void vm_set_fuel(vm_instance *vm, uint64_t fuel);
+void vm_set_timeout(vm_instance *vm, uint64_t milliseconds);
+void vm_interrupt(vm_instance *vm); // can be called from any thread
+
+// stdin of the program (the data must live until the run ends), and stdout kept in memory instead of written (until cleared)
+void vm_set_input(vm_instance *vm, const char *data, size_t size);
+void vm_capture_output(vm_instance *vm, int capture);
+const char *vm_output(vm_instance *vm, size_t *size);
+void vm_clear_output(vm_instance *vm);
+
+// arguments of the next runs (the push functions return 0 if the argument cannot be stored)
+void vm_clear_arguments(vm_instance *vm);
+int vm_push_int(vm_instance *vm, int64_t value);
+int vm_push_double(vm_instance *vm, double value);
+
+// runs the program once, returns 'VM_OK' or the exception that stopped it (an out of memory exception if the run cannot get its resources)
+int vm_run(vm_instance *vm);
+const char *vm_exception_name(int exception);
+
+// results of the last run (valid until the next run)
+size_t vm_result_count(const vm_instance *vm);
+vm_value_type vm_result_type(const vm_instance *vm, size_t index);
+int64_t vm_result_int(const vm_instance *vm, size_t index); // also the addr of a 'VM_VALUE_PTR'
+double vm_result_double(const vm_instance *vm, size_t index);
+const uint8_t *vm_memory(const vm_instance *vm, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBVM_H
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ A file mapped read-only and private (copy-on-write), used in place by the loaders of the '.vm' files and of the snapshots.
+ Opening it costs one 'mmap' whatever its size, the pages are only read from the disk when they are touched and
+ they are shared (page cache) by every process that maps the same file. The contents are 8 byte aligned.
+ */
+class Mapped_File {
+public:
+    ~Mapped_File();
+
+    Mapped_File(const Mapped_File &) = delete;
+    Mapped_File &operator=(const Mapped_File &) = delete;
+
+    static std::shared_ptr<const Mapped_File> open(const char *path); // null if the file cannot be read
+
+    inline std::span<const uint8_t> bytes() const { return std::span<const uint8_t>(static_cast<const uint8_t*>(contents), size); }
+
+private:
+    Mapped_File() : contents(nullptr), size(0), mapped(false) {}
+
+    const void *contents;
+    size_t size;
+    bool mapped;
+    std::vector<uint64_t> words; // the file contents when it cannot be mapped (empty files and systems without 'mmap')
+};
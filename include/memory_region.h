@@ -0,0 +1,36 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define HAS_GUARD_PAGE_HANDLER
+#endif
+
+/*
+ A block of virtual memory reserved up front and followed by a guard page (no access allowed).
+
+ Only the address space is reserved: the pages get physical memory the first time they are touched, so a big region
+ costs nothing until it is actually used (a vm stack grows on demand without ever being moved or resized).
+ A write into the guard page faults, so code that writes sequentially into the region (like an unchecked push) cannot
+ corrupt the memory after it. On platforms with 'HAS_GUARD_PAGE_HANDLER', a program can also choose to report these faults
+ as a stack overflow ('catch_guard_page_faults', used by vme). The handler is process-wide and ends the process, so it is
+ opt-in (the programs embedding libvm keep their own handlers) and only a last resort: the checked code still compares with the limit.
+ */
+class Memory_Region {
+public:
+    Memory_Region(size_t size); // throws 'std::bad_alloc' if the memory cannot be reserved
+    ~Memory_Region();
+
+    Memory_Region(const Memory_Region &) = delete;
+    Memory_Region &operator=(const Memory_Region &) = delete;
+
+    inline void  *data() const { return base; }
+    inline size_t size() const { return usable_size; }
+
+    static size_t page_size();
+    static void catch_guard_page_faults(); // installs the signal handler (once), the faults that are not on a guard page go to the previous handler
+
+private:
+    void  *base;
+    size_t usable_size; // 'size' rounded up to a multiple of the page size (the guard page starts right after)
+};
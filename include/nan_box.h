@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include <ostream>
+#include <bit>
 
 #include "exceptions.h"
 
@@ -11,32 +12,174 @@ enum class Nan_Type {
     EXCEPTION
 };
 
-class Nan_Box {
+/*
+ Value representations ('Encoding' of 'Basic_Box'), both store every value in 64 bits:
+
+ 'Nan_Encoding' (favors doubles): doubles are stored as they are and every other type is stored in a quiet nan,
+ with the type in bits 48-50 and the value in the lower 48 bits (ints are sign extended when read).
+ This is the representation of the assembler, the '.vm' files and the debugger.
+
+ 'Int_Encoding' (favors ints): ints are stored as they are (sign extended from 48 bits, so reading them is free),
+ pointers and exceptions use the otherwise unused top 16 bits 0x0001 and 0xFFFE, and doubles are offset by 2^49
+ so they never use those patterns (nans lose their payload, only the sign is kept).
+
+ In both, an int only has multiples of 2^48 above its lower 48 bits, so adding, subtracting or multiplying the raw bits
+ and boxing the result (which truncates it to 48 bits) gives the same result as doing it on the int values.
+ */
+struct Nan_Encoding {
+    static constexpr uint64_t SIGN_MASK  = 1ULL << 63ULL;
+    static constexpr uint64_t EXP_MASK   = 0x7FF0000000000000ULL; // also the bits of +infinity (the biggest value that is not a nan)
+    static constexpr uint64_t QNAN_BITS  = 0x7FF8000000000000ULL;
+    static constexpr uint64_t TYPE_MASK  = ((1ULL << 3ULL) - 1ULL) << 48ULL;
+    static constexpr uint64_t VALUE_MASK = (1ULL << 48ULL) - 1ULL;
+
+    // a value is an int if it is a nan with the int type (the type bits are not 0, so checking the exponent is enough)
+    static constexpr uint64_t INT_TAG_MASK = EXP_MASK | TYPE_MASK;
+    static constexpr uint64_t INT_TAG      = EXP_MASK | ((uint64_t)Nan_Type::INT << 48ULL);
+
+    static constexpr bool is_double(const uint64_t bits) { return (bits & ~SIGN_MASK) <= EXP_MASK; }
+    static constexpr bool is_int(const uint64_t bits) { return (bits & INT_TAG_MASK) == INT_TAG; }
+
+    // no short circuit, so a single branch
+    static constexpr bool both_int(const uint64_t lhs, const uint64_t rhs) {
+        return (((lhs & INT_TAG_MASK) ^ INT_TAG) | ((rhs & INT_TAG_MASK) ^ INT_TAG)) == 0;
+    }
+
+    static constexpr Nan_Type get_type(const uint64_t bits) {
+        if (is_double(bits))
+            return Nan_Type::DOUBLE;
+
+        return (Nan_Type) ((bits & TYPE_MASK) >> 48ULL);
+    }
+
+    static constexpr uint64_t encode_double(const double value) { return std::bit_cast<uint64_t>(value); }
+    static constexpr double   decode_double(const uint64_t bits) { return std::bit_cast<double>(bits); }
+
+    // bits of a value of any type other than double
+    static constexpr uint64_t encode(const Nan_Type type, const uint64_t value) {
+        return QNAN_BITS | ((uint64_t)type << 48ULL) | (value & VALUE_MASK);
+    }
+
+    // the value of any type other than double (ints are sign extended)
+    static constexpr uint64_t decode(const uint64_t bits) {
+        const uint64_t value = bits & VALUE_MASK;
+        if (is_int(bits))
+            return (uint64_t)((int64_t)(value << 16ULL) >> 16ULL);
+
+        return value;
+    }
+};
+
+struct Int_Encoding {
+    static constexpr uint64_t SIGN_MASK     = 1ULL << 63ULL;
+    static constexpr uint64_t QNAN_BITS     = 0x7FF8000000000000ULL;
+    static constexpr uint64_t VALUE_MASK    = (1ULL << 48ULL) - 1ULL;
+    static constexpr uint64_t DOUBLE_OFFSET = 1ULL << 49ULL;
+    static constexpr uint64_t PTR_TAG       = 0x0001ULL;
+    static constexpr uint64_t EXCEPTION_TAG = 0xFFFEULL;
+
+    // the top 16 bits of the doubles (after the offset) go from 0x0002 to 0x7FFA and from 0x8002 to 0xFFFA
+    static constexpr bool is_double(const uint64_t bits) { return (bits >> 48ULL) - 2ULL <= 0xFFF8ULL; }
+    static constexpr bool is_int(const uint64_t bits) { return bits + (1ULL << 47ULL) <= VALUE_MASK; }
+
+    // no short circuit, so a single branch
+    static constexpr bool both_int(const uint64_t lhs, const uint64_t rhs) {
+        return ((lhs + (1ULL << 47ULL)) | (rhs + (1ULL << 47ULL))) <= VALUE_MASK;
+    }
+
+    static constexpr Nan_Type get_type(const uint64_t bits) {
+        if (is_int(bits))
+            return Nan_Type::INT;
+
+        switch (bits >> 48ULL) {
+        case PTR_TAG:       return Nan_Type::PTR;
+        case EXCEPTION_TAG: return Nan_Type::EXCEPTION;
+        default:            return Nan_Type::DOUBLE;
+        }
+    }
+
+    static constexpr uint64_t encode_double(const double value) {
+        uint64_t bits = std::bit_cast<uint64_t>(value);
+        if (value != value)
+            bits = (bits & SIGN_MASK) | QNAN_BITS;
+
+        return bits + DOUBLE_OFFSET;
+    }
+
+    static constexpr double decode_double(const uint64_t bits) { return std::bit_cast<double>(bits - DOUBLE_OFFSET); }
+
+    static constexpr uint64_t encode(const Nan_Type type, const uint64_t value) {
+        switch (type) {
+        case Nan_Type::INT:       return (uint64_t)((int64_t)(value << 16ULL) >> 16ULL);
+        case Nan_Type::PTR:       return (PTR_TAG << 48ULL) | (value & VALUE_MASK);
+        case Nan_Type::EXCEPTION: return (EXCEPTION_TAG << 48ULL) | (value & VALUE_MASK);
+        case Nan_Type::DOUBLE:
+        default:                  return encode_double(std::bit_cast<double>(value));
+        }
+    }
+
+    static constexpr uint64_t decode(const uint64_t bits) {
+        if (is_int(bits))
+            return bits;
+
+        return bits & VALUE_MASK;
+    }
+};
+
+/*
+ A value of the vm, stored with the representation given by 'Encoding' (see above).
+
+ The core (type tests, boxing and unboxing) is defined here, with integer tests on the raw bits, so it can be inlined and
+ folded by the compiler everywhere. The operators only handle the common cases (both ints or both doubles) inline and
+ call the out-of-line '*_generic' functions, with the full type matrix, for everything else.
+ */
+template <typename Encoding>
+class Basic_Box {
 public:
-    Nan_Box() {}
-    Nan_Box(const double db_value)   : m_value(db_value) {}
-    Nan_Box(const int64_t int_value) : m_value(box_int(int_value)) {}
-    Nan_Box(const void *ptr_value)   : m_value(box_ptr(ptr_value)) {}
+    static constexpr uint64_t VALUE_MASK = (1ULL << 48ULL) - 1ULL;
+
+    Basic_Box() = default;
+    constexpr Basic_Box(const double db_value)   : m_bits(Encoding::encode_double(db_value)) {}
+    constexpr Basic_Box(const int64_t int_value) : m_bits(Encoding::encode(Nan_Type::INT, (uint64_t)int_value)) {}
+    Basic_Box(const void *ptr_value)             : m_bits(Encoding::encode(Nan_Type::PTR, (uint64_t)ptr_value)) {}
+
+    // converts a value from another representation
+    template <typename Other_Encoding>
+    explicit constexpr Basic_Box(const Basic_Box<Other_Encoding> &other) : m_bits(0) {
+        switch (other.get_type()) {
+        case Nan_Type::DOUBLE:    box_double(other.as_double());       break;
+        case Nan_Type::INT:       box_int(other.as_int());             break;
+        case Nan_Type::PTR:       m_bits = Encoding::encode(Nan_Type::PTR, (uint64_t)other.as_int()); break;
+        case Nan_Type::EXCEPTION: box_exception(other.as_exception()); break;
+        }
+    }
 
     // 'type' related functions
-    Nan_Type get_type() const;
+    constexpr uint64_t bits() const { return m_bits; }
+    constexpr bool is_double() const { return Encoding::is_double(m_bits); }
+    constexpr bool is_int() const { return Encoding::is_int(m_bits); }
+    constexpr Nan_Type get_type() const { return Encoding::get_type(m_bits); }
+
+    // fused type tests
+    static constexpr bool both_int(const Basic_Box &lhs, const Basic_Box &rhs) { return Encoding::both_int(lhs.m_bits, rhs.m_bits); }
+    static constexpr bool both_double(const Basic_Box &lhs, const Basic_Box &rhs) { return lhs.is_double() & rhs.is_double(); }
 
     // 'boxing' functions
-    inline double box_double(const double value)     { this->m_value = value; return this->m_value; }
-    double box_int(const int64_t value)              { this->set_type(Nan_Type::INT);       this->set_value((uint64_t)value); return this->m_value; }
-    double box_ptr(const void *const ptr)            { this->set_type(Nan_Type::PTR);       this->set_value((uint64_t)ptr);   return this->m_value; }
-    double box_exception(const Exception_Type value) { this->set_type(Nan_Type::EXCEPTION); this->set_value(value);           return this->m_value; }
+    constexpr double box_double(const double value)            { m_bits = Encoding::encode_double(value); return as_double(); }
+    constexpr double box_int(const int64_t value)              { m_bits = Encoding::encode(Nan_Type::INT, (uint64_t)value); return as_double(); }
+    double box_ptr(const void *const ptr)                      { m_bits = Encoding::encode(Nan_Type::PTR, (uint64_t)ptr); return as_double(); }
+    constexpr double box_exception(const Exception_Type value) { m_bits = Encoding::encode(Nan_Type::EXCEPTION, value); return as_double(); }
 
     // casting functions
-    inline double  as_double () const { return m_value; }
-    inline int64_t as_int    () const { return (int64_t) get_value(); }
-    inline void   *as_ptr    () const { return (void *)  get_value(); }
-    inline Exception_Type as_exception() { return (Exception_Type) get_value(); }
+    constexpr double  as_double () const { return Encoding::decode_double(m_bits); }
+    constexpr int64_t as_int    () const { return (int64_t) Encoding::decode(m_bits); }
+    inline    void   *as_ptr    () const { return (void *)  Encoding::decode(m_bits); }
+    constexpr Exception_Type as_exception() const { return (Exception_Type) Encoding::decode(m_bits); }
 
     // debug function
     // void print_bits_representation(uint8_t *const ptr, const size_t size);
 
-    friend std::ostream& operator<<(std::ostream& os, const Nan_Box& obj) {
+    friend std::ostream& operator<<(std::ostream& os, const Basic_Box& obj) {
         switch (obj.get_type()) {
         case Nan_Type::DOUBLE:
             os << obj.as_double();
@@ -45,7 +188,7 @@ public:
         case Nan_Type::INT:
             os << obj.as_int();
             break;
-        
+
         case Nan_Type::PTR:
             os << obj.as_ptr();
             break;
@@ -60,26 +203,138 @@ public:
     }
 
     // TODO: add exception handling to these operators
-    Nan_Box& operator+=(Nan_Box& rhs);
-    Nan_Box& operator-=(Nan_Box& rhs);
-    Nan_Box& operator*=(Nan_Box& rhs);
-    Nan_Box& operator/=(Nan_Box& rhs);
-    Nan_Box& operator%=(Nan_Box& rhs);
-    Nan_Box& operator<<=(Nan_Box& rhs);
-    Nan_Box& operator>>=(Nan_Box& rhs);
-    Nan_Box& operator&=(Nan_Box& rhs);
-    Nan_Box& operator|=(Nan_Box& rhs);
-    Nan_Box& operator^=(Nan_Box& rhs);
-    Nan_Box& operator~();
-    bool operator==(Nan_Box& rhs);
+    // the int operations are done on the raw bits (see the encodings)
+    constexpr Basic_Box& operator+=(Basic_Box& rhs) {
+        if (both_double(*this, rhs))
+            box_double(as_double() + rhs.as_double());
+        else if (both_int(*this, rhs))
+            box_int((int64_t)(m_bits + rhs.m_bits));
+        else
+            add_generic(rhs);
 
-private:
-    double m_value;
+        return *this;
+    }
 
-    // 'type' related functions
-    void set_type(const Nan_Type type);
+    constexpr Basic_Box& operator-=(Basic_Box& rhs) {
+        if (both_double(*this, rhs))
+            box_double(as_double() - rhs.as_double());
+        else if (both_int(*this, rhs))
+            box_int((int64_t)(m_bits - rhs.m_bits));
+        else
+            sub_generic(rhs);
+
+        return *this;
+    }
+
+    constexpr Basic_Box& operator*=(Basic_Box& rhs) {
+        if (both_double(*this, rhs))
+            box_double(as_double() * rhs.as_double());
+        else if (both_int(*this, rhs))
+            box_int((int64_t)(m_bits * rhs.m_bits));
+        else
+            mul_generic(rhs);
+
+        return *this;
+    }
+
+    constexpr Basic_Box& operator/=(Basic_Box& rhs) {
+        // the int division can give a double (see 'div_generic')
+        if (both_double(*this, rhs) && rhs.as_double() != 0.0)
+            box_double(as_double() / rhs.as_double());
+        else
+            div_generic(rhs);
+
+        return *this;
+    }
+
+    // the rest of the operators only work with ints
+    constexpr Basic_Box& operator%=(Basic_Box& rhs) {
+        if (both_int(*this, rhs))
+            box_int(as_int() % rhs.as_int());
+        else
+            box_exception(Exception_Type::EXCEPTION_MODULO_NON_INT);
+
+        return *this;
+    }
+
+    constexpr Basic_Box& operator<<=(Basic_Box& rhs) {
+        if (both_int(*this, rhs))
+            box_int(as_int() << rhs.as_int());
+        else
+            box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
+
+        return *this;
+    }
+
+    // arithmetic shift
+    constexpr Basic_Box& operator>>=(Basic_Box& rhs) {
+        if (both_int(*this, rhs))
+            box_int(as_int() >> rhs.as_int());
+        else
+            box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
 
-    // 'value' related functions
-    uint64_t get_value() const;
-    void     set_value(const uint64_t value);
+        return *this;
+    }
+
+    constexpr Basic_Box& operator&=(Basic_Box& rhs) {
+        if (both_int(*this, rhs))
+            box_int(as_int() & rhs.as_int());
+        else
+            box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
+
+        return *this;
+    }
+
+    constexpr Basic_Box& operator|=(Basic_Box& rhs) {
+        if (both_int(*this, rhs))
+            box_int(as_int() | rhs.as_int());
+        else
+            box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
+
+        return *this;
+    }
+
+    constexpr Basic_Box& operator^=(Basic_Box& rhs) {
+        if (both_int(*this, rhs))
+            box_int(as_int() ^ rhs.as_int());
+        else
+            box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
+
+        return *this;
+    }
+
+    constexpr Basic_Box& operator~() {
+        if (is_int())
+            box_int(~as_int());
+        else
+            box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
+
+        return *this;
+    }
+
+    constexpr bool operator==(Basic_Box& rhs) {
+        if (both_double(*this, rhs))
+            return as_double() == rhs.as_double();
+        else if (both_int(*this, rhs))
+            return ((m_bits ^ rhs.m_bits) & VALUE_MASK) == 0;
+
+        return equals_generic(rhs);
+    }
+
+    // out-of-line versions of the operators with the full type matrix
+    Basic_Box& add_generic(Basic_Box& rhs);
+    Basic_Box& sub_generic(Basic_Box& rhs);
+    Basic_Box& mul_generic(Basic_Box& rhs);
+    Basic_Box& div_generic(Basic_Box& rhs);
+    bool equals_generic(Basic_Box& rhs);
+
+private:
+    uint64_t m_bits;
 };
+
+typedef Basic_Box<Nan_Encoding> Nan_Box;
+typedef Basic_Box<Int_Encoding> Int_Box;
+
+// the generic operators are instantiated in 'nan_box.cpp'
+extern template class Basic_Box<Nan_Encoding>;
+extern template class Basic_Box<Int_Encoding>;
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <string_view>
+#include <atomic>
+#include <thread>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024) // bytes written at once with 'Flush_Policy::SIZE'
+#define OUTPUT_RING_SIZE 8             // buffers in flight with the background writer
+
+// when the buffered output is written to the file
+enum class Flush_Policy {
+    LINE = 0, // at the end of every line (default for terminals)
+    SIZE,     // when the buffer is full (default for files and pipes)
+    EXIT      // only when the program ends (the buffer grows as needed)
+};
+
+/*
+ Buffered output of the vm (used by 'print' and by the 'fwrite' native), numbers are formatted with 'std::to_chars'.
+
+ Without the background writer the buffer is written directly to the file, big writes go out with the buffer in one 'writev'.
+ With the background writer the full buffers are handed to a thread through a lock-free single producer / single consumer ring,
+ the thread writes all the buffers it finds in the ring with one 'writev'. The interpreter only waits if all the buffers are in flight.
+
+ With 'set_capture' nothing is written to the file, the output stays in the buffer until it is taken with 'captured' and 'clear'
+ (used by the batch mode of vme to collect the output of each record).
+ */
+class Output {
+public:
+    Output(int fd);
+    Output(int fd, Flush_Policy policy);
+    ~Output();
+
+    Output(const Output &) = delete;
+    Output &operator=(const Output &) = delete;
+
+    void set_policy(Flush_Policy policy);
+    void set_background(bool background); // starts/stops the writer thread (stopping waits for all the pending writes)
+    void set_capture(bool capture);       // keeps the output in memory instead of writing it (stops the writer thread)
+    inline std::string_view captured() { return std::string_view(current().data(), current().size()); }
+    inline void clear() { current().clear(); }
+
+    void write(const char *data, size_t size);
+    void write_int(int64_t value);
+    void write_double(double value); // same format as 'std::ostream' by default ('%g')
+    void write_ptr(uint64_t value);  // hex with the '0x' prefix
+    inline void put(const char c) { write(&c, 1); }
+
+    void flush(); // writes (or hands to the writer) everything buffered so far
+    void sync();  // 'flush' and wait until it is in the file (call it before writing to the same file in other ways)
+
+private:
+    void writer_loop();
+    inline std::vector<char> &current() { return buffers[head.load(std::memory_order_relaxed) % OUTPUT_RING_SIZE]; }
+
+    int fd;
+    Flush_Policy policy;
+
+    // the buffer being filled is 'buffers[head % OUTPUT_RING_SIZE]', the writer owns the ones in [tail, head)
+    std::vector<char> buffers[OUTPUT_RING_SIZE];
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+
+    bool background;
+    bool capture;
+    std::atomic<bool> stopping;
+    std::thread writer;
+};
@@ -4,16 +4,14 @@
 
 #include "lexer.h"
 #include "program.h"
+#include "symbol_table.h"
 
-typedef struct {
-    void *points_to;
-    Token *token;
-} Label;
-
+// a use of a label before its definition
 typedef struct {
     size_t inst_idx;
-    const Token &token;
-} Unresolved_Label;
+    uint32_t symbol; // see 'Symbol_Table'
+    Token token;     // the use (for the errors)
+} Label_Fixup;
 
 class Parser {
 public:
@@ -24,6 +22,7 @@ private:
     void parse_inst();
     void parse_label();
     void parse_directive();
+    void define(const Token &name, Symbol_Kind kind, Token_Type type, Nan_Box value);
     Nan_Box token_as_Nan_Box(const Token &token);
     const Token &next(const Token_Type acc_types[], size_t acc_types_size, bool ignore_keyword_type_check = false);
 
@@ -35,10 +34,10 @@ private:
      of the 'include' directive. In the end, the first created Lexer and Parser, both need to have access to valid data.
      */
     std::vector<Inst> insts;
-    std::vector<Nan_Box> memory;
-    std::vector<Unresolved_Label> unresolved_labels;
-    std::unordered_map<std::string, Token> alias;
-    std::unordered_map<std::string, Label> labels;
+    std::vector<uint8_t> memory;
+    uint64_t bss_size; // zero bytes reserved after 'memory' (not stored yet)
+    std::vector<Label_Fixup> fixups;
+    Symbol_Table symbols; // the labels and the aliases
 
     // used to stores the names for the included files to avoid circular file inclusion
     std::unordered_set<std::string> includes;
@@ -1,67 +1,58 @@
 #pragma once
 #include <vector>
 #include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
 
 #include "inst.h"
+#include "code.h"
+#include "verifier.h"
+#include "mapped_file.h"
 
 class Program {
 public:
     Program(const Inst *list, const size_t count);
     Program() {}
-    ~Program() {}
 
     static void write_to_file(const char *path, const Inst *program, const size_t program_size);
     void write_to_file(const char *path);
     void read_from_file(const char *path);
+    bool read_from_memory(const uint8_t *data, size_t size, std::string &error); // the contents of a '.vm' file (see 'bytecode.h')
     void print_program(bool with_labels = false);
+    void decode(bool fuse = true);
 
-    // basic program serialization
-    friend std::ofstream& operator<<(std::ofstream& ofs, const Program& program) {
-        // write the memory size to the binary file
-        const size_t mem_size = program.memory.size();
-        ofs.write((const char *)&mem_size, static_cast<std::streamsize>(sizeof(mem_size)));
-
-        // write the memory to the binary file
-        ofs.write((const char *)program.memory.data(), static_cast<std::streamsize>(sizeof(Nan_Box) * mem_size));
-
-        // write the instructions size to the binary file
-        const size_t insts_size = program.insts.size();
-        ofs.write((const char *)&insts_size, static_cast<std::streamsize>(sizeof(insts_size)));
-
-        // write the instructions size to the binary file
-        ofs.write((const char *)program.insts.data(), static_cast<std::streamsize>(sizeof(Inst) * insts_size));
-        return ofs;
-    }
-
-    // basic program deserialization
-    friend std::ifstream& operator>>(std::ifstream& ifs, Program& program) {
-        // read the memory size from the binary file
-        size_t mem_size;
-        ifs.read((char *)&mem_size, sizeof(mem_size));
-
-        // read the memory from the binary file
-        Nan_Box new_nan_box;
-        program.memory.reserve(mem_size); // reserve the size necessary to store all the static memory data
-        for (size_t i = 0; i < mem_size; i++) {
-            ifs.read((char *)&new_nan_box, sizeof(Nan_Box));
-            program.memory.push_back(new_nan_box);
-        }
-
-        // read the instructions size from the binary file
-        size_t insts_size;
-        ifs.read((char *)&insts_size, sizeof(insts_size));
-
-        // read the instructions from the binary file
-        Inst new_inst;
-        program.insts.reserve(insts_size); // reserve the size necessary to store all the instructions
-        for (size_t i = 0; i < insts_size; i++) {
-            ifs.read((char *)&new_inst, sizeof(Inst));
-            program.insts.push_back(new_inst);
-        }
+    std::vector<Inst> insts;
+    std::vector<uint8_t> memory; // static memory (byte addressable)
+    uint64_t bss_size = 0;       // zero bytes after 'memory' (the blocks reserved with '%res' after the last string, only their size is stored)
+    std::vector<std::pair<std::string, uint64_t>> symbols; // names of the labels and their addrs, sorted by addr (only used by the disassembler)
 
-        return ifs;
-    }
+    // pre-decoded 'insts' and the result of its verification (see 'decode')
+    Code code;
+    Verification verification;
+};
 
-    std::vector<Inst> insts;
-    std::vector<Nan_Box> memory;
+/*
+ The loaded form of a program, it never changes after it is built so one image can be shared by any number of vms (on any number of threads).
+ It only has the parts that are read at runtime: the instructions (used by the switch loop and vdb), the decoded code
+ (each vm re-encodes and quickens its own copy) and the verification. 'data' is the initial static memory, each vm clones it
+ into its own writable memory at the start of every run (followed by 'bss_size' zero bytes, then the heap), so the image is never written.
+ An image loaded from a '.vm' file keeps the file mapped and 'data' points into it, so the processes that run the same
+ program share its pages instead of each holding a private copy.
+ */
+class Image {
+public:
+    Image(Program &&program, bool fuse = true); // decodes the program if it was not decoded yet (the program is moved, not copied)
+    Image(Program &&program, std::shared_ptr<const Mapped_File> file, std::span<const uint8_t> data, bool fuse = true); // 'data' is in 'file'
+    static std::shared_ptr<const Image> load(const char *path, std::string &error, bool fuse = true); // null (and the reason in 'error') on errors
+
+    const std::vector<Inst> insts;
+    const std::shared_ptr<const Mapped_File> file; // null when the image was not loaded from a file
+    const std::vector<uint8_t> owned_data;        // the static memory when it is not in 'file'
+    const std::span<const uint8_t> data;
+    const uint64_t bss_size; // zero bytes after 'data' (mapped by each vm, see 'Vm_Memory')
+    const Code code;
+    const Verification verification;
+    const uint64_t fingerprint; // hash of the instructions and the data (a snapshot can only be restored with the same program)
 };
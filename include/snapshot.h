@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nan_box.h"
+#include "mapped_file.h"
+
+#define SNAPSHOT_MAGIC 0x3130504e53534d56ULL // "VMSSNP01" (little-endian)
+
+/*
+ The state of a vm at the 'snapshot' native: the ip, the stack, the memory (static memory and heap) and the bookkeeping of the heap.
+ A vm given a snapshot (see 'Basic_Vm::set_snapshot') starts every run from it instead of from the start of the program,
+ so a program that spends most of its time building tables before doing the actual work only does that setup once.
+
+ File layout (8 byte little-endian words): magic, fingerprint of the image, ip, stack size, memory size, number of heap words,
+ then the stack (always as 'Nan_Box', whatever the representation of the vm), the memory (padded to 8 bytes) and the heap words.
+ The file is mapped (see 'Mapped_File') and used in place, so the pages are only read from the file when a vm copies them
+ into its own memory, and one snapshot can be shared by any number of vms.
+ The memory is copied at the start of every run on purpose, instead of being mapped copy-on-write into the vm: the memory
+ section is not page aligned in the file, and the memory of a vm must stay a single anonymous mapping to grow in place
+ (see 'Vm_Memory'). The copy only covers the memory the program had at the snapshot.
+ */
+class Snapshot {
+public:
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    static std::shared_ptr<const Snapshot> load(const char *path, std::string &error); // null (and the reason in 'error') on errors
+    static bool write(const char *path, uint64_t fingerprint, uint64_t ip, std::span<const Nan_Box> stack, std::span<const uint8_t> memory, std::span<const uint64_t> heap);
+
+    uint64_t fingerprint;
+    uint64_t ip;
+    std::span<const Nan_Box> stack;
+    std::span<const uint8_t> memory;
+    std::span<const uint64_t> heap;
+
+private:
+    Snapshot() {}
+
+    std::shared_ptr<const Mapped_File> file;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "lexer.h"
+#include "nan_box.h"
+
+typedef enum {
+    SYMBOL_UNDEFINED = 0, // only used (a label defined later or a missing one)
+    SYMBOL_LABEL,
+    SYMBOL_ALIAS          // '%alias', '%string' and '%res'
+} Symbol_Kind;
+
+typedef struct {
+    std::string_view name;
+    Symbol_Kind kind;
+    Token_Type type;  // of the value of an alias ('INTEGER' or 'FP')
+    Nan_Box value;    // the addr of a label or the value of an alias (resolved once, when it is defined)
+    Token definition; // where it was defined (for the errors)
+} Symbol;
+
+/*
+ The labels and aliases of a program, each name is interned once and then referred to by its id (an index in 'symbols').
+ The names point into the tokens (see 'Lexer'), so they are never copied.
+ */
+class Symbol_Table {
+public:
+    uint32_t intern(std::string_view name); // the id of 'name' (a new undefined symbol the first time)
+    bool find(std::string_view name, uint32_t &id) const; // false if 'name' was never interned
+
+    inline Symbol       &operator[](const uint32_t id)       { return symbols[id]; }
+    inline const Symbol &operator[](const uint32_t id) const { return symbols[id]; }
+    inline const std::vector<Symbol> &all() const { return symbols; }
+
+private:
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::vector<Symbol> symbols;
+};
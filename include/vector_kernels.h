@@ -0,0 +1,49 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define HAS_X86_VECTOR_KERNELS
+#endif
+
+#define VECTOR_ELEMENT_SIZE 8 // bytes per element in memory (for both Doubles and Ints)
+
+// instruction sets with vector kernels (the best one supported by the cpu is selected at runtime)
+typedef enum {
+    VECTOR_ISA_SCALAR = 0,
+    VECTOR_ISA_SSE2,
+    VECTOR_ISA_AVX2,
+    VECTOR_ISA_AVX512,
+    VECTOR_ISA_COUNT
+} Vector_Isa;
+
+/*
+ Kernels of the vector instructions for the element type 'T' (double or int64_t).
+ The arrays are in the vm memory: 8 byte little-endian elements with no alignment, 'n' is the number of elements.
+ The int kernels wrap around on overflow. The element-wise double results are the same with every instruction set ('vfma'
+ rounds the product and then the sum, it is built without contraction to fused multiply-adds), the double reductions might
+ round differently (the partial sums are added in a different order).
+ */
+template <typename T>
+struct Vector_Ops {
+    void (*add)  (uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n);
+    void (*sub)  (uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n);
+    void (*mul)  (uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n);
+    bool (*div)  (uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n); // false on an int division by zero ('dst' is partially written)
+    void (*fma)  (uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n); // dst += a * b
+    void (*scale)(uint8_t *dst, const uint8_t *a, T s, size_t n);
+    T    (*dot)  (const uint8_t *a, const uint8_t *b, size_t n);
+    T    (*sum)  (const uint8_t *a, size_t n);
+    T    (*min)  (const uint8_t *a, size_t n); // 'n' must be bigger than 0
+    T    (*max)  (const uint8_t *a, size_t n); // 'n' must be bigger than 0
+};
+
+typedef struct {
+    const char *name;
+    Vector_Ops<double>  f64;
+    Vector_Ops<int64_t> i64;
+} Vector_Kernels;
+
+bool vector_isa_supported(Vector_Isa isa);
+const Vector_Kernels &vector_kernels(Vector_Isa isa);
+const Vector_Kernels &vector_kernels(); // the best kernels for this cpu (selected once)
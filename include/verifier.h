@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdint.h>
+
+#include "code.h"
+
+#define COROUTINE_ENTRY_DEPTH 2 // values on the stack of a new coroutine (the argument and the return addr)
+
+typedef struct {
+    uint64_t entry;    // addr of the first instruction (0 for the entry point of the program)
+    size_t max_height; // max number of values on the stack above the function entry (including the functions it calls)
+} Function_Info;
+
+typedef struct {
+    bool verified = false;       // true if the stack depth of every reachable instruction is known and no instruction can underflow
+    std::string error;           // why the program could not be verified
+    size_t max_stack_height = 0; // max number of values on the stack during the whole execution (only valid if 'verified')
+    std::vector<Function_Info> functions;
+} Verification;
+
+/*
+ Load time stack-effect verifier.
+
+ Runs an abstract interpretation over the control flow graph of each function (the entry point and every 'call' target),
+ computing the stack depth before every reachable instruction, relative to the depth at the function entry.
+ A program is verified when:
+    - every instruction is always reached with the same depth (loops do not grow or shrink the stack);
+    - no instruction can take more values from the stack than there are (including the values of the caller);
+    - every 'ret' returns with the return addr pushed by the 'call' still on top of the stack (it is tracked through
+      'swap', 'dup' and friends) so the depth after each 'call' is known;
+    - there is no recursion.
+ The 'spawn' targets are verified as functions too, each coroutine runs with its own stack starting with 'COROUTINE_ENTRY_DEPTH' values.
+ Verified programs whose 'max_stack_height' fits in the vm stack can run without any stack bounds checks.
+ */
+class Verifier {
+public:
+    Verifier(const Code &code) : code(code) {}
+
+    Verification verify();
+
+private:
+    typedef struct {
+        bool in_progress;
+        bool returns;      // false when every path ends the program
+        int64_t need;      // values that must be on the stack at the entry
+        int64_t ret_depth; // depth after 'ret', relative to the entry
+        int64_t max;       // max depth, relative to the entry
+        int64_t low_write; // lowest stack position (relative to the entry) the function might change
+    } Summary;
+
+    bool analyze(uint64_t entry, bool is_function);
+    bool fail(uint64_t addr, const std::string &reason);
+
+    const Code &code;
+    std::unordered_map<uint64_t, Summary> summaries;
+    std::vector<uint64_t> function_order;
+    std::vector<uint64_t> spawn_entries;
+    std::unordered_set<uint64_t> spawned; // the targets in 'spawn_entries'
+    std::string error;
+};
@@ -1,11 +1,23 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <queue>
+#include <string_view>
+#include <span>
 
 #include "exceptions.h"
 #include "program.h"
 #include "inst.h"
 #include "nan_box.h"
+#include "memory_region.h"
+#include "heap.h"
+#include "output.h"
+#include "vector_kernels.h"
+#include "io_queue.h"
+#include "snapshot.h"
 
 // macro used with the read and write instructions to cast the value to the requested size
 #define CAST_TO_SIZE(size, value) \
@@ -13,55 +25,233 @@
     (size == 16 ? (int64_t)(int16_t)(value) : \
     (size == 32 ? (int64_t)(int32_t)(value) : (int64_t)(value))))
 
-#define STACK_CAP 1024
+#define STACK_CAP 1024 // used just in the x86_64 code generator (the vm stack size is set per instance)
+#define DEFAULT_STACK_CAP (1 << 20) // max number of values in the vm stack (only the used part takes memory)
 #define WORD_SIZE sizeof(Nan_Box) // used just in the x86_64 code generator
-#define DEFAULT_STATIC_MEM_CAP 300
-#define EXECUTION_LIMIT 10000
+#define UNLIMITED_FUEL UINT64_MAX // default number of instructions a program can execute
+#define SLEEP_SLICE std::chrono::milliseconds(10) // max time the vm waits for a sleeping coroutine before checking for interrupts
 
-class Vm {
+// the interpreter loop used by 'execute_program'
+enum class Dispatch_Mode {
+    SWITCH = 0, // one call to 'execute_instruction' per instruction (also used by vdb)
+    THREADED,   // direct-threaded loop (computed goto when available, switch otherwise)
+    PROFILE     // same as 'SWITCH' but records the frequency of the instructions and of the sequences of 2 and 3 instructions
+};
+
+/*
+ The virtual machine, 'Box' is the representation of the values in the stack (see 'Basic_Box'), the memory is made of bytes.
+ The program is always stored as 'Nan_Box' (like in the '.vm' files), the vm converts it when it starts the execution.
+ The vm only reads the image of the program, so many vms (on different threads) can run the same image at the same time.
+ */
+template <typename Box>
+class Basic_Vm {
 private:
-    Exception_Type execute_instruction(Inst& inst);
+    Exception_Type execute_instruction(const Inst& inst);
+    Exception_Type run_threaded();
+    template <bool checked> Exception_Type run_loop();
+    Exception_Type run_profiled();
+    Exception_Type consume_fuel(uint64_t insts);
+    bool reset(); // false if the memory of the program cannot be reserved
+
+    // helpers shared by both interpreter loops
+    void print_value(Box &value);
+    static void cast_to_double(Box &value);
+    static void cast_to_int(Box &value);
+    static void cast_to_ptr(Box &value);
+    bool mem_addr(const Box &ptr, size_t size, size_t &addr);
+    static bool mem_size(const Box &value, size_t &size);
+    bool vector_addr(const Box &ptr, size_t n, size_t &addr);
+    template <typename T> Exception_Type execute_vector(Inst_Type type, const Vector_Ops<T> &ops);
 
-    Program &program;
+    std::shared_ptr<const Image> image;
 
-    // stack
-    // TODO: replace the stack with a vector
-    Nan_Box stack[STACK_CAP];
+    // the vm own copy of the code (quickening rewrites it) and of the memory (byte addressable, cloned from the image on every run)
+    Code code;
+    Vm_Memory memory;
+    Heap heap; // after the static memory, used by the 'malloc' and 'free' natives
+
+    // stack (grows on demand up to 'stack_cap' values, see 'Memory_Region')
+    Memory_Region stack_region;
+    Box *stack;
+    size_t stack_cap;
     size_t sp;
 
     // program
     uint64_t ip;
     size_t current_program_size;
 
+    // execution limits
+    uint64_t fuel;
+    uint64_t fuel_limit;
+    std::chrono::milliseconds timeout;
+    std::atomic<bool> interrupted;
+
+    // buffered stdout and stderr (used by 'print' and 'fwrite')
+    Output out;
+    Output err;
+    void sync_output();
+
+    /*
+     Coroutines, scheduled cooperatively on the thread running the vm ('spawn', 'yield', 'join' and 'sleep' switch between them).
+     The running coroutine always uses the vm stack (so the stack checks and the guard page work as usual), the others keep
+     a copy of just the values they had on the stack, so a suspended coroutine only takes the memory it uses.
+     A coroutine ends when its entry function returns (to the end of the code), the program ends when the first one (id 0) does.
+     */
+    typedef enum {
+        COROUTINE_RUNNING = 0,
+        COROUTINE_READY,
+        COROUTINE_SLEEPING,
+        COROUTINE_JOINING,
+        COROUTINE_DONE
+    } Coroutine_State;
+
+    typedef struct {
+        Coroutine_State state;
+        uint64_t ip;
+        std::vector<Box> stack;        // the saved stack (empty while running)
+        std::vector<uint64_t> joiners; // coroutines waiting for this one to end
+        Box result;                    // top of the stack when it ended
+    } Coroutine;
+
+    typedef std::pair<std::chrono::steady_clock::time_point, uint64_t> Sleeper; // wake up time and id
+
+    std::vector<Coroutine> coroutines; // the index is the id
+    uint64_t current_coroutine;
+    std::deque<uint64_t> ready_coroutines;
+    std::priority_queue<Sleeper, std::vector<Sleeper>, std::greater<Sleeper>> sleeping_coroutines;
+
+    void reset_coroutines();
+    Exception_Type spawn_coroutine(uint64_t entry);
+    Exception_Type yield_coroutine();
+    Exception_Type join_coroutine();
+    Exception_Type sleep_coroutine();
+    Exception_Type end_of_code(); // the end of the program or of a coroutine
+    Exception_Type switch_coroutine();
+
+    // files opened by the program and their queued reads/writes (closed on every run)
+    Io_Queue io;
+
+    // state every run starts from (see 'set_snapshot') and where the 'snapshot' native saves it (see 'set_snapshot_output')
+    std::shared_ptr<const Snapshot> snapshot;
+    std::string snapshot_output;
+
+    // pushed on the stack at the start of every run (see 'get_arguments')
+    std::vector<Box> arguments;
+
+    // stdin of the program (see 'set_input')
+    std::string_view input;
+    bool has_input;
+
+    // profiling (only filled with 'Dispatch_Mode::PROFILE')
+    std::vector<uint64_t> inst_counts;
+    std::vector<uint64_t> pair_counts;
+    std::vector<uint64_t> triple_counts;
+
     // native functions
-    typedef void (Vm::*Native_Func)();
-    void native_malloc();
-    void native_free();
-    void native_fwrite();
+    typedef Exception_Type (Basic_Vm::*Native_Func)();
+    Exception_Type native_malloc();
+    Exception_Type native_free();
+    Exception_Type native_fwrite();
+    Exception_Type native_fread();
+    Exception_Type native_fopen();
+    Exception_Type native_fclose();
+    Exception_Type native_aread();
+    Exception_Type native_awrite();
+    Exception_Type native_asubmit();
+    Exception_Type native_apoll();
+    Exception_Type native_await();
+    Exception_Type native_snapshot();
+    Exception_Type queue_io(Io_Op op);
+    bool io_request(const Box &value, uint64_t &id);
 
     constexpr static const Native_Func native_funcs_addrs[] = {
-        &Vm::native_malloc,
-        &Vm::native_free,
-        &Vm::native_fwrite
+        &Basic_Vm::native_malloc,
+        &Basic_Vm::native_free,
+        &Basic_Vm::native_fwrite,
+        &Basic_Vm::native_fread,
+        &Basic_Vm::native_fopen,
+        &Basic_Vm::native_fclose,
+        &Basic_Vm::native_aread,
+        &Basic_Vm::native_awrite,
+        &Basic_Vm::native_asubmit,
+        &Basic_Vm::native_apoll,
+        &Basic_Vm::native_await,
+        &Basic_Vm::native_snapshot
     };
 
 public:
-    Vm(Program &program) : program(program) {};
-    ~Vm() {};
+    // both throw 'std::bad_alloc' if the stack or the memory cannot be reserved
+    Basic_Vm(std::shared_ptr<const Image> image, size_t stack_cap = DEFAULT_STACK_CAP);
+    Basic_Vm(const Program &program, size_t stack_cap = DEFAULT_STACK_CAP); // builds an image with a copy of the program
+
+    ~Basic_Vm() {};
 
-    void execute_program(bool debug_mode = false);
+    void execute_program(bool debug_mode = false, Dispatch_Mode mode = Dispatch_Mode::THREADED); // exits on exceptions
+    Exception_Type run(Dispatch_Mode mode = Dispatch_Mode::THREADED); // one run of the program, returns the exception that stopped it (or 'EXCEPTION_OK')
     Exception_Type next();
     inline uint64_t get_ip() { return ip; }
+    inline const Image &get_image() { return *image; }
+    inline size_t get_stack_cap() { return stack_cap; }
+    inline const Vm_Memory &get_memory() const { return memory; }
+    inline const Heap &get_heap() { return heap; }
+    inline size_t get_coroutines_count() { return coroutines.size(); } // coroutines started by the last run (including the first one)
+    inline Output &get_output() { return out; } // to change how the stdout of the program is buffered
+    inline Output &get_error_output() { return err; }
+
+    /*
+     Arguments and results without going through stdin/stdout: the arguments are pushed on the stack at the start of every run
+     (after the state of the snapshot, if any), so the first one is the deepest. The results are the values left on the stack
+     by the last run (valid until the next one).
+     */
+    inline std::vector<Box> &get_arguments() { return arguments; }
+    inline std::span<const Box> get_results() const { return std::span<const Box>(stack, sp); }
+
+    // the bytes read by the 'fread' native from stdin (without it the vm reads the stdin of the process)
+    inline void set_input(std::string_view input) { this->input = input; has_input = true; }
+
+    /*
+     Warm start: the 'snapshot' native marks the end of the setup of a program. With 'set_snapshot_output' it saves the state
+     of the vm there and stops the run, with 'set_snapshot' every run starts from the saved state (right after the native)
+     instead of from the start of the program. 'set_snapshot' returns false if the snapshot was taken with another program
+     or does not fit in this vm, or if its memory cannot be reserved (a null snapshot goes back to starting from the program).
+     */
+    bool set_snapshot(std::shared_ptr<const Snapshot> snapshot);
+    inline void set_snapshot_output(std::string path) { snapshot_output = std::move(path); }
+
+    // execution limits, going over them raises 'EXCEPTION_OUT_OF_FUEL' or 'EXCEPTION_INTERRUPTED'
+    // the threaded loop only checks them when the control flow changes (jumps, calls, returns), so it can go over the fuel by one basic block
+    inline void set_fuel(uint64_t fuel) { this->fuel = fuel; fuel_limit = fuel; } // for each run
+    inline uint64_t get_fuel() { return fuel; } // what is left
+    inline void set_timeout(std::chrono::milliseconds timeout) { this->timeout = timeout; } // 0 means no timeout
+    inline void interrupt() { interrupted.store(true, std::memory_order_relaxed); } // can be called from any thread
 
     // debug functions
     void dump_stack();
     void dump_memory();
+    static void dump_bytes(std::ostream &os, std::span<const uint8_t> bytes, size_t begin, size_t end); // hex dump of [begin, end)
+    void dump_profile(std::ostream &os, size_t top = 20);
 
     constexpr static std::string_view native_funcs_names[] = {
         "malloc",
         "free",
-        "fwrite"
+        "fwrite",
+        "fread",
+        "fopen",
+        "fclose",
+        "aread",
+        "awrite",
+        "asubmit",
+        "apoll",
+        "await",
+        "snapshot"
     };
 
     constexpr static size_t native_funcs_count = sizeof(native_funcs_addrs) / sizeof(Native_Func);
 };
+
+typedef Basic_Vm<Nan_Box> Vm;
+typedef Basic_Vm<Int_Box> Int_Vm;
+
+// instantiated in 'vm.cpp' and 'vm_threaded.cpp'
+extern template class Basic_Vm<Nan_Box>;
+extern template class Basic_Vm<Int_Box>;
@@ -0,0 +1,43 @@
+#pragma once
+#include <span>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ The byte addressable memory of a vm: the static memory, the zero-filled blocks reserved with '%res' and the heap.
+ It is anonymous memory and every byte past 'size' is zero, so growing it costs nothing until the new pages are
+ touched (a '%res buf 100000000' only takes the pages the program writes) and shrinking it gives the pages back.
+
+ The data of the image is copied in at the start of every run instead of being mapped copy-on-write from the '.vm' file.
+ The data section is not page aligned in the file (and an image can also be loaded from memory, see 'vm_image_load'),
+ and a mapping that mixes file and anonymous pages cannot grow with 'mremap'. Mapping it again on every run would cost
+ syscalls and a page fault per touched page, while the copy is one 'memcpy' of the data section only (the '%res' blocks
+ and the heap are never copied).
+ */
+class Vm_Memory {
+public:
+    Vm_Memory() : base(nullptr), used(0), capacity(0) {}
+    ~Vm_Memory();
+
+    Vm_Memory(const Vm_Memory &) = delete;
+    Vm_Memory &operator=(const Vm_Memory &) = delete;
+
+    // both return false if the memory could not be reserved (nothing is changed then)
+    bool assign(std::span<const uint8_t> bytes, size_t zeros = 0); // 'bytes' followed by 'zeros' zero bytes
+    bool resize(size_t size); // the new bytes are zero
+
+    inline uint8_t       &operator[](const size_t addr)       { return base[addr]; }
+    inline const uint8_t &operator[](const size_t addr) const { return base[addr]; }
+    inline uint8_t       *data()       { return base; }
+    inline const uint8_t *data() const { return base; }
+    inline size_t         size() const { return used; }
+    inline std::span<const uint8_t> bytes() const { return std::span<const uint8_t>(base, used); }
+
+private:
+    bool reserve(size_t size);
+    void clear(size_t begin, size_t end); // zeroes [begin, end)
+
+    uint8_t *base;
+    size_t used;
+    size_t capacity; // bytes mapped (a multiple of the page size)
+};
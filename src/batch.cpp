@@ -0,0 +1,99 @@
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "batch.h"
+
+template <typename Box>
+Batch<Box>::Batch(std::shared_ptr<const Image> image, const size_t workers, const size_t stack_cap, const Dispatch_Mode mode, Setup setup)
+    : image(std::move(image)),
+      workers(std::max<size_t>(workers, 1)),
+      stack_cap(stack_cap),
+      mode(mode),
+      setup(std::move(setup)),
+      queues(new Queue[this->workers]) {}
+
+template <typename Box>
+bool Batch<Box>::next_record(const size_t worker, size_t &record) {
+    {
+        std::lock_guard lock(queues[worker].mutex);
+        if (!queues[worker].records.empty()) {
+            record = queues[worker].records.front();
+            queues[worker].records.pop_front();
+            return true;
+        }
+    }
+
+    // steal the last record of another worker (no records are added while running, so all the queues empty means the end)
+    for (size_t i = 1; i < workers; i++) {
+        Queue &victim = queues[(worker + i) % workers];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.records.empty()) {
+            record = victim.records.back();
+            victim.records.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename Box>
+size_t Batch<Box>::run(const std::vector<std::string_view> &records, const Emit &emit) {
+    const size_t count = records.size();
+    std::vector<Batch_Result> results(count);
+    std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[count]);
+    for (size_t i = 0; i < count; i++)
+        done[i].store(false, std::memory_order_relaxed);
+
+    for (size_t worker = 0; worker < workers; worker++) {
+        for (size_t i = count * worker / workers; i < count * (worker + 1) / workers; i++)
+            queues[worker].records.push_back(i);
+    }
+
+    // the vms are built before starting the workers, so a vm that cannot be reserved throws here
+    std::vector<std::unique_ptr<Basic_Vm<Box>>> vms;
+    for (size_t worker = 0; worker < workers; worker++)
+        vms.push_back(std::make_unique<Basic_Vm<Box>>(image, stack_cap));
+
+    std::vector<std::jthread> threads;
+    for (size_t worker = 0; worker < workers; worker++) {
+        threads.emplace_back([this, worker, &records, &results, &done, &vms]() {
+            Basic_Vm<Box> &vm = *vms[worker];
+            vm.get_output().set_capture(true);
+            vm.get_error_output().set_capture(true);
+            setup(vm);
+
+            size_t record;
+            while (next_record(worker, record)) {
+                Batch_Result &result = results[record];
+                vm.set_input(records[record]);
+                result.exception = vm.run(mode);
+
+                result.out = vm.get_output().captured();
+                result.err = vm.get_error_output().captured();
+                vm.get_output().clear();
+                vm.get_error_output().clear();
+
+                done[record].store(true, std::memory_order_release);
+                done[record].notify_one();
+            }
+        });
+    }
+
+    // the results go out in order (the memory of each one is released right after)
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++) {
+        done[i].wait(false, std::memory_order_acquire);
+        emit(i, results[i]);
+
+        if (results[i].exception != Exception_Type::EXCEPTION_OK)
+            failed++;
+        results[i] = Batch_Result {};
+    }
+
+    return failed;
+}
+
+template class Batch<Nan_Box>;
+template class Batch<Int_Box>;
@@ -0,0 +1,360 @@
+#include <cstring>
+#include <bit>
+#include <unordered_map>
+
+#include "bytecode.h"
+
+#define HEADER_SIZE 16
+#define SECTION_ENTRY_SIZE 24
+#define OPCODE_BITS 6
+
+static_assert(Inst_Type::INST_COUNT <= (1 << OPCODE_BITS), "the opcodes do not fit in the low bits of the instruction byte");
+
+// little-endian writers (the sections are appended to 'out')
+static void put_u16(std::vector<uint8_t> &out, const uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+static void put_u32(std::vector<uint8_t> &out, const uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+static void put_u64(std::vector<uint8_t> &out, const uint64_t value) {
+    for (int i = 0; i < 8; i++)
+        out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint64_t get_u64(const uint8_t *const data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    if constexpr (std::endian::native == std::endian::little)
+        return value;
+
+    value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= static_cast<uint64_t>(data[i]) << (i * 8);
+    return value;
+}
+
+static uint32_t get_u32(const uint8_t *const data) {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+// reads the varints of one section, every read checks the end of the section
+class Section_Reader {
+public:
+    Section_Reader(const uint8_t *data, size_t size) : pos(data), end(data + size) {}
+
+    bool varint(uint64_t &value) {
+        value = 0;
+        for (unsigned shift = 0; shift < 64 && pos < end; shift += 7) {
+            const uint8_t byte = *pos++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    bool bytes(const size_t size, const uint8_t *&data) {
+        if (size > static_cast<size_t>(end - pos))
+            return false;
+
+        data = pos;
+        pos += size;
+        return true;
+    }
+
+    inline size_t left() const { return static_cast<size_t>(end - pos); }
+
+private:
+    const uint8_t *pos;
+    const uint8_t *end;
+};
+
+// hashes 8 bytes at a time (multiply and rotate, with the final mix of murmur3), much faster than a byte at a time
+static uint64_t checksum(const uint8_t *const data, const size_t size) {
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+        hash = std::rotl((hash ^ get_u64(data + i)) * 0xbf58476d1ce4e5b9ULL, 31);
+
+    uint64_t tail = 0;
+    for (size_t j = 0; i + j < size; j++)
+        tail |= static_cast<uint64_t>(data[i + j]) << (j * 8);
+    hash = std::rotl((hash ^ tail) * 0xbf58476d1ce4e5b9ULL, 31);
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+std::vector<uint8_t> encode_program(const Program &program) {
+    std::vector<uint8_t> code, constants, symbols, bss;
+    std::vector<uint64_t> pool;
+    std::unordered_map<uint64_t, uint64_t> pool_index; // bits of the value -> index in the pool
+
+    put_varint(code, program.insts.size());
+    for (const Inst &inst: program.insts) {
+        const Nan_Box operand = inst.operand;
+        Operand_Kind kind = OPERAND_NONE;
+
+        // the operands of the instructions that do not take one are not kept
+        if (inst_requires_operand(inst.type)) {
+            switch (operand.get_type()) {
+            case Nan_Type::INT: kind = operand.as_int() == 0 ? OPERAND_NONE : OPERAND_INT; break;
+            case Nan_Type::PTR: kind = OPERAND_ADDR; break;
+            case Nan_Type::DOUBLE:
+            case Nan_Type::EXCEPTION:
+            default:
+                kind = OPERAND_CONSTANT;
+                break;
+            }
+        }
+
+        code.push_back(static_cast<uint8_t>(inst.type | kind << OPCODE_BITS));
+        switch (kind) {
+        case OPERAND_INT: {
+            const int64_t value = operand.as_int();
+            put_varint(code, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); // zigzag
+            break;
+        }
+
+        case OPERAND_ADDR:
+            put_varint(code, reinterpret_cast<uint64_t>(operand.as_ptr()));
+            break;
+
+        case OPERAND_CONSTANT: {
+            const auto [it, added] = pool_index.try_emplace(operand.bits(), pool.size());
+            if (added)
+                pool.push_back(operand.bits());
+            put_varint(code, it->second);
+            break;
+        }
+
+        case OPERAND_NONE:
+        default:
+            break;
+        }
+    }
+
+    put_varint(constants, pool.size());
+    for (const uint64_t bits: pool)
+        put_u64(constants, bits);
+
+    put_varint(symbols, program.symbols.size());
+    for (const auto &[name, addr]: program.symbols) {
+        put_varint(symbols, addr);
+        put_varint(symbols, name.size());
+        symbols.insert(symbols.end(), name.begin(), name.end());
+    }
+
+    put_varint(bss, program.bss_size);
+
+    const std::pair<Section_Id, const std::vector<uint8_t>*> sections[] = {
+        {SECTION_CODE, &code},
+        {SECTION_CONSTANTS, &constants},
+        {SECTION_DATA, &program.memory},
+        {SECTION_SYMBOLS, &symbols},
+        {SECTION_BSS, &bss}
+    };
+    const size_t sections_count = sizeof(sections) / sizeof(sections[0]);
+
+    std::vector<uint8_t> out;
+    for (int i = 0; i < 4; i++)
+        out.push_back(static_cast<uint8_t>(BYTECODE_MAGIC[i]));
+    put_u16(out, BYTECODE_VERSION);
+    put_u16(out, 0);
+    put_u32(out, static_cast<uint32_t>(sections_count));
+    put_u32(out, 0);
+
+    uint64_t offset = HEADER_SIZE + sections_count * SECTION_ENTRY_SIZE;
+    for (const auto &[id, section]: sections) {
+        put_u32(out, id);
+        put_u32(out, 0);
+        put_u64(out, offset);
+        put_u64(out, section->size());
+        offset += section->size();
+    }
+
+    for (const auto &[id, section]: sections)
+        out.insert(out.end(), section->begin(), section->end());
+
+    put_u64(out, checksum(out.data(), out.size()));
+    return out;
+}
+
+bool decode_program(const uint8_t *const data, const size_t size, Program &program, std::string &error) {
+    std::span<const uint8_t> memory;
+    if (!decode_program(data, size, program, memory, error))
+        return false;
+
+    program.memory.assign(memory.begin(), memory.end());
+    return true;
+}
+
+bool decode_program(const uint8_t *const data, const size_t size, Program &program, std::span<const uint8_t> &memory, std::string &error) {
+    if (size < HEADER_SIZE + 8 || std::memcmp(data, BYTECODE_MAGIC, 4) != 0) {
+        error = "not a vm file (or one from an older vasma, assemble it again)";
+        return false;
+    }
+
+    const uint16_t version = static_cast<uint16_t>(data[4] | data[5] << 8);
+    if (version != BYTECODE_VERSION) {
+        error = "unsupported version " + std::to_string(version) + " (expected " + std::to_string(BYTECODE_VERSION) + ")";
+        return false;
+    }
+
+    // everything else is only read after the checksum matched
+    const size_t body_size = size - 8;
+    if (checksum(data, body_size) != get_u64(data + body_size)) {
+        error = "the checksum does not match (the file is corrupted)";
+        return false;
+    }
+
+    const uint32_t sections_count = get_u32(data + 8);
+    if (sections_count > (body_size - HEADER_SIZE) / SECTION_ENTRY_SIZE) {
+        error = "the section table is corrupted";
+        return false;
+    }
+
+    Section_Reader sections[SECTION_BSS + 1] = {
+        {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, {nullptr, 0}
+    };
+    bool found[SECTION_BSS + 1] = {};
+
+    for (uint32_t i = 0; i < sections_count; i++) {
+        const uint8_t *const entry = data + HEADER_SIZE + i * SECTION_ENTRY_SIZE;
+        const uint32_t id = get_u32(entry);
+        const uint64_t offset = get_u64(entry + 8), section_size = get_u64(entry + 16);
+        if (offset > body_size || section_size > body_size - offset) {
+            error = "section " + std::to_string(id) + " is out of the file";
+            return false;
+        }
+
+        if (id >= SECTION_CODE && id <= SECTION_BSS) {
+            sections[id] = Section_Reader(data + offset, section_size);
+            found[id] = true;
+        }
+    }
+
+    if (!found[SECTION_CODE] || !found[SECTION_CONSTANTS] || !found[SECTION_DATA]) {
+        error = "the code, constants or data section is missing";
+        return false;
+    }
+
+    // constant pool
+    Section_Reader &constants = sections[SECTION_CONSTANTS];
+    uint64_t pool_size;
+    const uint8_t *pool;
+    if (!constants.varint(pool_size) || pool_size > constants.left() / 8 || !constants.bytes(pool_size * 8, pool)) {
+        error = "the constant pool is corrupted";
+        return false;
+    }
+
+    // code
+    Section_Reader &code = sections[SECTION_CODE];
+    uint64_t insts_count;
+    if (!code.varint(insts_count) || insts_count > code.left()) {
+        error = "the code section is corrupted";
+        return false;
+    }
+
+    program.insts.resize(insts_count);
+    for (Inst &inst: program.insts) {
+        const uint8_t *byte;
+        if (!code.bytes(1, byte) || (*byte & ((1 << OPCODE_BITS) - 1)) >= Inst_Type::INST_COUNT) {
+            error = "the code section is corrupted";
+            return false;
+        }
+
+        inst.type = static_cast<Inst_Type>(*byte & ((1 << OPCODE_BITS) - 1));
+        inst.operand = Nan_Box(static_cast<int64_t>(0));
+
+        uint64_t value = 0;
+        const Operand_Kind kind = static_cast<Operand_Kind>(*byte >> OPCODE_BITS);
+        if (kind != OPERAND_NONE && !code.varint(value)) {
+            error = "the code section is corrupted";
+            return false;
+        }
+
+        switch (kind) {
+        case OPERAND_INT:
+            inst.operand = Nan_Box(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1));
+            break;
+
+        case OPERAND_ADDR:
+            inst.operand.box_ptr(reinterpret_cast<void*>(value));
+            break;
+
+        case OPERAND_CONSTANT: {
+            if (value >= pool_size) {
+                error = "the code section is corrupted";
+                return false;
+            }
+
+            inst.operand = std::bit_cast<Nan_Box>(get_u64(pool + value * 8));
+            break;
+        }
+
+        case OPERAND_NONE:
+        default:
+            break;
+        }
+    }
+
+    // static memory
+    Section_Reader &data_section = sections[SECTION_DATA];
+    const size_t memory_size = data_section.left();
+    const uint8_t *bytes;
+    data_section.bytes(memory_size, bytes);
+    memory = std::span<const uint8_t>(bytes, memory_size);
+
+    // zero bytes (optional)
+    program.bss_size = 0;
+    if (found[SECTION_BSS] && !sections[SECTION_BSS].varint(program.bss_size)) {
+        error = "the bss section is corrupted";
+        return false;
+    }
+
+    // symbols (optional)
+    program.symbols.clear();
+    if (found[SECTION_SYMBOLS]) {
+        Section_Reader &symbols = sections[SECTION_SYMBOLS];
+        uint64_t symbols_count;
+        if (!symbols.varint(symbols_count) || symbols_count > symbols.left() / 2) {
+            error = "the symbols section is corrupted";
+            return false;
+        }
+
+        program.symbols.resize(symbols_count);
+        for (auto &[name, addr]: program.symbols) {
+            uint64_t name_size;
+            const uint8_t *name_data;
+            if (!symbols.varint(addr) || !symbols.varint(name_size) || !symbols.bytes(name_size, name_data)) {
+                error = "the symbols section is corrupted";
+                return false;
+            }
+
+            name.assign(reinterpret_cast<const char*>(name_data), name_size);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,230 @@
+#include <bit>
+#include <initializer_list>
+
+#include "code.h"
+#include "exceptions.h"
+
+Code::Code(const std::vector<Inst> &insts, const size_t native_funcs_count) : program_size(insts.size()) {
+    ops.reserve(insts.size() + 2);
+    operands.reserve(insts.size() + 2);
+
+    for (const Inst &inst: insts) {
+        uint8_t op = static_cast<uint8_t>(inst.type);
+        int64_t operand = 0;
+
+        switch (inst.type) {
+        case Inst_Type::INST_PUSH:
+            operand = std::bit_cast<int64_t>(inst.operand);
+            break;
+
+        case Inst_Type::INST_JMP:
+        case Inst_Type::INST_CALL:
+        case Inst_Type::INST_SPAWN:
+            // no need to check for negative addrs
+            operand = static_cast<int64_t>((uint64_t)inst.operand.as_ptr() < program_size ? (uint64_t)inst.operand.as_ptr() : trap_addr());
+            break;
+
+        case Inst_Type::INST_JMP_IF:
+            // an out of range 'jif' just ends the program
+            operand = static_cast<int64_t>((uint64_t)inst.operand.as_ptr() < program_size ? (uint64_t)inst.operand.as_ptr() : end_addr());
+            break;
+
+        case Inst_Type::INST_DUP:
+        case Inst_Type::INST_SWAP:
+        case Inst_Type::INST_PRINT:
+        case Inst_Type::INST_TD:
+        case Inst_Type::INST_TI:
+        case Inst_Type::INST_TP:
+            if (inst.operand.as_int() < 0) {
+                op = OP_TRAP;
+                operand = Exception_Type::EXCEPTION_STACK_OVERFLOW;
+            } else {
+                operand = inst.operand.as_int() + 1;
+            }
+            break;
+
+        case Inst_Type::INST_READ:
+        case Inst_Type::INST_WRITE:
+            operand = inst.operand.as_int();
+            if (operand != 8 && operand != 16 && operand != 32 && operand != 64) {
+                op = OP_TRAP;
+                operand = Exception_Type::EXCEPTION_INVALID_READ_WRITE_SIZE;
+            }
+            break;
+
+        case Inst_Type::INST_VADD:
+        case Inst_Type::INST_VSUB:
+        case Inst_Type::INST_VMUL:
+        case Inst_Type::INST_VDIV:
+        case Inst_Type::INST_VFMA:
+        case Inst_Type::INST_VSCALE:
+        case Inst_Type::INST_VDOT:
+        case Inst_Type::INST_VSUM:
+        case Inst_Type::INST_VMIN:
+        case Inst_Type::INST_VMAX:
+            operand = inst.operand.as_int();
+            if (operand < 0 || operand >= VECTOR_TYPE_COUNT) {
+                op = OP_TRAP;
+                operand = Exception_Type::EXCEPTION_INVALID_VECTOR_TYPE;
+            }
+            break;
+
+        case Inst_Type::INST_NATIVE:
+            operand = inst.operand.as_int();
+            if (operand < 0 || static_cast<size_t>(operand) >= native_funcs_count) {
+                op = OP_TRAP;
+                operand = Exception_Type::EXCEPTION_UNKNOWN_INSTRUCTION;
+            }
+            break;
+
+        case Inst_Type::INST_NOP:
+        case Inst_Type::INST_EXIT:
+        case Inst_Type::INST_POP:
+        case Inst_Type::INST_ADD:
+        case Inst_Type::INST_SUB:
+        case Inst_Type::INST_MUL:
+        case Inst_Type::INST_DIV:
+        case Inst_Type::INST_MOD:
+        case Inst_Type::INST_AND:
+        case Inst_Type::INST_OR:
+        case Inst_Type::INST_XOR:
+        case Inst_Type::INST_NOT:
+        case Inst_Type::INST_SHL:
+        case Inst_Type::INST_SHR:
+        case Inst_Type::INST_SAR:
+        case Inst_Type::INST_EQU:
+        case Inst_Type::INST_RET:
+        case Inst_Type::INST_DUMP_STACK:
+        case Inst_Type::INST_READF:
+        case Inst_Type::INST_WRITEF:
+        case Inst_Type::INST_COPY:
+        case Inst_Type::INST_FILL:
+        case Inst_Type::INST_COMPARE:
+        case Inst_Type::INST_YIELD:
+        case Inst_Type::INST_JOIN:
+        case Inst_Type::INST_SLEEP:
+        case Inst_Type::INST_DUMP_MEMORY:
+        case Inst_Type::INST_HALT:
+            break;
+
+        case Inst_Type::INST_COUNT:
+        default:
+            op = OP_TRAP;
+            operand = Exception_Type::EXCEPTION_UNKNOWN_INSTRUCTION;
+            break;
+        }
+
+        ops.push_back(op);
+        operands.push_back(operand);
+    }
+
+    // end of the program
+    ops.push_back(Inst_Type::INST_EXIT);
+    operands.push_back(0);
+
+    // target for the invalid jumps
+    ops.push_back(OP_TRAP);
+    operands.push_back(Exception_Type::EXCEPTION_INVALID_JMP_ADDR);
+
+    dequickens.assign(ops.size(), 0);
+}
+
+void Code::fuse() {
+    // returns true if the instructions at 'addr' are exactly 'seq' (never matches the instructions appended after the program)
+    auto matches = [this](const uint64_t addr, std::initializer_list<uint8_t> seq) {
+        if (addr + seq.size() > program_size)
+            return false;
+
+        uint64_t i = addr;
+        for (const uint8_t op: seq) {
+            if (ops[i++] != op)
+                return false;
+        }
+
+        return true;
+    };
+
+    uint64_t addr = 0;
+    while (addr < program_size) {
+        if (matches(addr, {INST_PUSH, INST_EQU, INST_JMP_IF})) {
+            ops[addr] = OP_PUSH_EQU_JIF;
+            addr += 3;
+        } else if (matches(addr, {INST_SWAP, INST_POP})) {
+            ops[addr] = OP_SWAP_POP;
+            addr += 2;
+        } else if (matches(addr, {INST_PUSH, INST_ADD})) {
+            ops[addr] = OP_PUSH_ADD;
+            addr += 2;
+        } else if (matches(addr, {INST_DUP, INST_ADD})) {
+            ops[addr] = OP_DUP_ADD;
+            addr += 2;
+        } else if (matches(addr, {INST_DUP, INST_DUP})) {
+            ops[addr] = OP_DUP_DUP;
+            addr += 2;
+        } else {
+            addr++;
+        }
+    }
+}
+
+void Code::quicken(const uint64_t addr, const Nan_Type lhs, const Nan_Type rhs) {
+    if (!can_quicken(addr) || lhs != rhs)
+        return;
+
+    const bool ints = lhs == Nan_Type::INT;
+    const bool doubles = lhs == Nan_Type::DOUBLE;
+
+    switch (ops[addr]) {
+    case Inst_Type::INST_ADD:
+        if (ints || doubles)
+            ops[addr] = ints ? OP_ADD_II : OP_ADD_DD;
+        break;
+
+    case Inst_Type::INST_SUB:
+        if (ints || doubles)
+            ops[addr] = ints ? OP_SUB_II : OP_SUB_DD;
+        break;
+
+    case Inst_Type::INST_MUL:
+        if (ints || doubles)
+            ops[addr] = ints ? OP_MUL_II : OP_MUL_DD;
+        break;
+
+    case Inst_Type::INST_DIV:
+        // int division has to check for 0 and convert the result (not worth it)
+        if (doubles)
+            ops[addr] = OP_DIV_DD;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void Code::dequicken(const uint64_t addr) {
+    switch (ops[addr]) {
+    case OP_ADD_II:
+    case OP_ADD_DD:
+        ops[addr] = Inst_Type::INST_ADD;
+        break;
+
+    case OP_SUB_II:
+    case OP_SUB_DD:
+        ops[addr] = Inst_Type::INST_SUB;
+        break;
+
+    case OP_MUL_II:
+    case OP_MUL_DD:
+        ops[addr] = Inst_Type::INST_MUL;
+        break;
+
+    case OP_DIV_DD:
+        ops[addr] = Inst_Type::INST_DIV;
+        break;
+
+    default:
+        return;
+    }
+
+    dequickens[addr]++;
+}
@@ -2,11 +2,11 @@
 
 #include "program.h"
 #include "program_args.h"
-#include "parser.h"
 
 void program_usage(const char* program_name) {
     std::cerr << "Usage: " << program_name << " [args]" << std::endl;
-    std::cerr << "    args: -i: Input file name of the executable to disassemble." << std::endl;
+    std::cerr << "    args: -i: Input file name of the executable ('.vm') to disassemble." << std::endl;
+    std::cerr << "          -l: Print the labels (with their names from the source when the executable has them)." << std::endl;
 }
 
 int main(int argc, char* argv[]) {
@@ -28,9 +28,7 @@ int main(int argc, char* argv[]) {
     const bool print_with_labels = program_args::has_option(args, "-l");
 
     Program p;
-    Lexer lexer(input_file_path.data());
-    Parser parser(lexer.tokenize());
-    parser.parse(&p);
+    p.read_from_file(input_file_path.data());
     p.print_program(print_with_labels);
     return 0;
 }
@@ -1,85 +1,50 @@
 #include <iostream>
+#include <string_view>
 
 #include "exceptions.h"
 
-void exception_handler(Exception_Type exception) {
-    std::cerr << "ERROR: Exception occured ";
-
+const char *exception_as_cstr(const Exception_Type exception) {
     switch (exception) {
-    case EXCEPTION_OK:
-    case EXCEPTION_EXIT:
-        return;
-
-    case EXCEPTION_UNKNOWN_INSTRUCTION:
-        std::cerr << "'EXCEPTION_UNKNOWN_INSTRUCTION'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_STACK_OVERFLOW:
-        std::cerr << "'EXCEPTION_STACK_OVERFLOW'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_STACK_UNDERFLOW:
-        std::cerr << "'EXCEPTION_STACK_UNDERFLOW'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_INVALID_JMP_ADDR:
-        std::cerr << "'EXCEPTION_INVALID_JMP_ADDR'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_DIV_BY_ZERO:
-        std::cerr << "'EXCEPTION_DIV_BY_ZERO'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_UNKNOWN_STACK_DATA_TYPE:
-        std::cerr << "'EXCEPTION_UNKNOWN_STACK_DATA_TYPE'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_SUBTRACT_POINTER_AND_DOUBLE:
-        std::cerr << "'EXCEPTION_SUBTRACT_POINTER_AND_DOUBLE'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_SUBTRACT_POINTER_AND_INT:
-        std::cerr << "'EXCEPTION_SUBTRACT_POINTER_AND_INT'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_ADD_POINTER_AND_DOUBLE:
-        std::cerr << "'EXCEPTION_ADD_POINTER_AND_DOUBLE'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_ADD_TWO_POINTERS:
-        std::cerr << "'EXCEPTION_ADD_TWO_POINTERS'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_MUL_POINTER:
-        std::cerr << "'EXCEPTION_MUL_POINTER'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_DIV_POINTER:
-        std::cerr << "'EXCEPTION_DIV_POINTER'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_INVALID_RET_ADDR:
-        std::cerr << "'EXCEPTION_INVALID_RET_ADDR'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_BITWISE_NON_INT:
-        std::cerr << "'EXCEPTION_BITWISE_NON_INT'" << std::endl;
-        exit(1);
-
-    case EXCEPTION_INVALID_MEM_ADDR:
-        std::cerr << "'EXCEPTION_INVALID_MEM_ADDR'" << std::endl;
-        exit(1);
+    case EXCEPTION_OK:                          return "EXCEPTION_OK";
+    case EXCEPTION_EXIT:                        return "EXCEPTION_EXIT";
+    case EXCEPTION_UNKNOWN_INSTRUCTION:         return "EXCEPTION_UNKNOWN_INSTRUCTION";
+    case EXCEPTION_STACK_OVERFLOW:              return "EXCEPTION_STACK_OVERFLOW";
+    case EXCEPTION_STACK_UNDERFLOW:             return "EXCEPTION_STACK_UNDERFLOW";
+    case EXCEPTION_INVALID_JMP_ADDR:            return "EXCEPTION_INVALID_JMP_ADDR";
+    case EXCEPTION_DIV_BY_ZERO:                 return "EXCEPTION_DIV_BY_ZERO";
+    case EXCEPTION_UNKNOWN_STACK_DATA_TYPE:     return "EXCEPTION_UNKNOWN_STACK_DATA_TYPE";
+    case EXCEPTION_SUBTRACT_POINTER_AND_DOUBLE: return "EXCEPTION_SUBTRACT_POINTER_AND_DOUBLE";
+    case EXCEPTION_SUBTRACT_POINTER_AND_INT:    return "EXCEPTION_SUBTRACT_POINTER_AND_INT";
+    case EXCEPTION_ADD_POINTER_AND_DOUBLE:      return "EXCEPTION_ADD_POINTER_AND_DOUBLE";
+    case EXCEPTION_ADD_TWO_POINTERS:            return "EXCEPTION_ADD_TWO_POINTERS";
+    case EXCEPTION_MUL_POINTER:                 return "EXCEPTION_MUL_POINTER";
+    case EXCEPTION_DIV_POINTER:                 return "EXCEPTION_DIV_POINTER";
+    case EXCEPTION_INVALID_RET_ADDR:            return "EXCEPTION_INVALID_RET_ADDR";
+    case EXCEPTION_BITWISE_NON_INT:             return "EXCEPTION_BITWISE_NON_INT";
+    case EXCEPTION_INVALID_MEM_ADDR:            return "EXCEPTION_INVALID_MEM_ADDR";
+    case EXCEPTION_INVALID_READ_WRITE_SIZE:     return "EXCEPTION_INVALID_READ_WRITE";
+    case EXCEPTION_MODULO_NON_INT:              return "EXCEPTION_MODULO_NON_INT";
+    case EXCEPTION_OUT_OF_FUEL:                 return "EXCEPTION_OUT_OF_FUEL";
+    case EXCEPTION_INTERRUPTED:                 return "EXCEPTION_INTERRUPTED";
+    case EXCEPTION_INVALID_VECTOR_TYPE:         return "EXCEPTION_INVALID_VECTOR_TYPE";
+    case EXCEPTION_INVALID_COROUTINE:           return "EXCEPTION_INVALID_COROUTINE";
+    case EXCEPTION_DEADLOCK:                    return "EXCEPTION_DEADLOCK";
+    case EXCEPTION_INVALID_IO_REQUEST:          return "EXCEPTION_INVALID_IO_REQUEST";
+    case EXCEPTION_INVALID_FD:                  return "EXCEPTION_INVALID_FD";
+    case EXCEPTION_SNAPSHOT_FAILED:             return "EXCEPTION_SNAPSHOT_FAILED";
+    case EXCEPTION_OUT_OF_MEMORY:               return "EXCEPTION_OUT_OF_MEMORY";
+    default:                                    return "EXCEPTION_UNKNOWN";
+    }
+}
 
-    case EXCEPTION_INVALID_READ_WRITE_SIZE:
-        std::cerr << "'EXCEPTION_INVALID_READ_WRITE'" << std::endl;
-        exit(1);
+void exception_handler(Exception_Type exception) {
+    if (exception == EXCEPTION_OK || exception == EXCEPTION_EXIT)
+        return;
 
-    case EXCEPTION_MODULO_NON_INT:
-        std::cerr << "'EXCEPTION_MODULO_NON_INT'" << std::endl;
-        exit(1);
+    std::cerr << "ERROR: Exception occured ";
+    if (exception_as_cstr(exception) == std::string_view("EXCEPTION_UNKNOWN"))
+        std::cerr << "when handling another exception: ";
 
-    default:
-        std::cerr << "when handling another exception: 'EXCEPTION_UNKNOWN'" << std::endl;
-        exit(1);
-    }
+    std::cerr << "'" << exception_as_cstr(exception) << "'" << std::endl;
+    exit(1);
 }
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <new>
+
+#include "heap.h"
+
+Heap::Heap(Vm_Memory &memory, const size_t cap) : memory(memory), cap(cap) {
+    if (!reset())
+        throw std::bad_alloc();
+}
+
+bool Heap::reset() {
+    // the addr 0 is reserved for the failed allocations (and the blocks are aligned)
+    base = std::max<uint64_t>(memory.size(), HEAP_ALIGN);
+    base = (base + HEAP_ALIGN - 1) / HEAP_ALIGN * HEAP_ALIGN;
+    const bool reserved = memory.resize(base);
+
+    arenas.clear();
+    live.clear();
+    free_large.clear();
+    for (size_t i = 0; i < HEAP_SIZE_CLASSES; i++) {
+        free_lists[i].clear();
+        bump[i] = 0;
+        bump_end[i] = 0;
+    }
+
+    stats = Heap_Stats {0, 0, 0, 0, 0, 0, 0};
+    return reserved;
+}
+
+bool Heap::new_arenas(const uint64_t count, const uint8_t size_class, uint64_t &addr) {
+    if (count == 0 || (arenas.size() + count) * HEAP_ARENA_SIZE > cap)
+        return false;
+
+    // the memory might not be able to grow even under the cap
+    if (!memory.resize(base + (arenas.size() + count) * HEAP_ARENA_SIZE))
+        return false;
+
+    addr = base + arenas.size() * HEAP_ARENA_SIZE;
+    arenas.push_back(Arena {size_class, count});
+    for (uint64_t i = 1; i < count; i++)
+        arenas.push_back(Arena {CONTINUATION, 0});
+
+    live.resize((arenas.size() * HEAP_ARENA_SIZE / HEAP_ALIGN + 63) / 64, 0);
+    stats.arenas = arenas.size();
+    return true;
+}
+
+bool Heap::is_live(const uint64_t addr) const {
+    const uint64_t bit = (addr - base) / HEAP_ALIGN;
+    return (live[bit / 64] >> (bit % 64)) & 1;
+}
+
+void Heap::set_live(const uint64_t addr, const bool value) {
+    const uint64_t bit = (addr - base) / HEAP_ALIGN;
+    if (value)
+        live[bit / 64] |= 1ULL << (bit % 64);
+    else
+        live[bit / 64] &= ~(1ULL << (bit % 64));
+}
+
+uint64_t Heap::allocate(const size_t size) {
+    uint64_t addr = 0;
+    size_t block_size;
+
+    // checked before rounding the size up to arenas (a negative size wraps around to a huge one)
+    if (size > cap) {
+        stats.failed_allocations++;
+        return 0;
+    }
+
+    if (size <= class_size(HEAP_SIZE_CLASSES - 1)) {
+        // smallest class that fits
+        uint8_t size_class = 0;
+        while (class_size(size_class) < size)
+            size_class++;
+
+        block_size = class_size(size_class);
+        std::vector<uint64_t> &free_list = free_lists[size_class];
+
+        if (!free_list.empty()) {
+            addr = free_list.back();
+            free_list.pop_back();
+        } else {
+            if (bump[size_class] == bump_end[size_class]) {
+                if (!new_arenas(1, size_class, bump[size_class])) {
+                    stats.failed_allocations++;
+                    return 0;
+                }
+
+                bump_end[size_class] = bump[size_class] + HEAP_ARENA_SIZE;
+            }
+
+            addr = bump[size_class];
+            bump[size_class] += block_size;
+        }
+    } else {
+        const uint64_t span = (size + HEAP_ARENA_SIZE - 1) / HEAP_ARENA_SIZE;
+        block_size = span * HEAP_ARENA_SIZE;
+
+        // first free run of arenas that is big enough (what is left stays free)
+        const auto it = std::find_if(free_large.begin(), free_large.end(), [span](const std::pair<uint64_t, uint64_t> &run) { return run.second >= span; });
+        if (it != free_large.end()) {
+            addr = it->first;
+            const uint64_t first = (addr - base) / HEAP_ARENA_SIZE;
+            arenas[first] = Arena {LARGE_CLASS, span};
+
+            if (it->second > span) {
+                it->first += span * HEAP_ARENA_SIZE;
+                it->second -= span;
+                arenas[first + span] = Arena {LARGE_CLASS, it->second};
+            } else {
+                free_large.erase(it);
+            }
+        } else if (!new_arenas(span, LARGE_CLASS, addr)) {
+            stats.failed_allocations++;
+            return 0;
+        }
+    }
+
+    set_live(addr, true);
+    stats.allocations++;
+    stats.live_bytes += block_size;
+    stats.peak_live_bytes = std::max(stats.peak_live_bytes, stats.live_bytes);
+    return addr;
+}
+
+bool Heap::release(const uint64_t addr) {
+    if (addr == 0)
+        return true;
+
+    // only the start of a live block can be freed
+    if (addr < base || addr >= base + arenas.size() * HEAP_ARENA_SIZE || addr % HEAP_ALIGN != 0 || !is_live(addr)) {
+        stats.invalid_frees++;
+        return false;
+    }
+
+    const Arena &arena = arenas[(addr - base) / HEAP_ARENA_SIZE];
+    set_live(addr, false);
+    stats.frees++;
+
+    if (arena.size_class == LARGE_CLASS) {
+        stats.live_bytes -= arena.span * HEAP_ARENA_SIZE;
+        free_large.push_back({addr, arena.span});
+    } else {
+        stats.live_bytes -= class_size(arena.size_class);
+        free_lists[arena.size_class].push_back(addr);
+    }
+
+    return true;
+}
+
+void Heap::save(std::vector<uint64_t> &words) const {
+    words.push_back(base);
+    words.insert(words.end(), {stats.allocations, stats.frees, stats.failed_allocations, stats.invalid_frees, stats.live_bytes, stats.peak_live_bytes, stats.arenas});
+
+    words.push_back(arenas.size());
+    for (const Arena &arena: arenas) {
+        words.push_back(arena.size_class);
+        words.push_back(arena.span);
+    }
+
+    words.push_back(live.size());
+    words.insert(words.end(), live.begin(), live.end());
+
+    for (size_t i = 0; i < HEAP_SIZE_CLASSES; i++) {
+        words.push_back(free_lists[i].size());
+        words.insert(words.end(), free_lists[i].begin(), free_lists[i].end());
+        words.push_back(bump[i]);
+        words.push_back(bump_end[i]);
+    }
+
+    words.push_back(free_large.size());
+    for (const auto &[addr, span]: free_large) {
+        words.push_back(addr);
+        words.push_back(span);
+    }
+}
+
+bool Heap::load(const uint64_t *const words, const size_t count) {
+    size_t pos = 0;
+    const auto next = [&](uint64_t &word) {
+        if (pos >= count)
+            return false;
+
+        word = words[pos++];
+        return true;
+    };
+
+    // the arenas must end at the end of the restored memory
+    uint64_t arenas_count, live_count;
+    if (!next(base) || !next(stats.allocations) || !next(stats.frees) || !next(stats.failed_allocations) || !next(stats.invalid_frees)
+        || !next(stats.live_bytes) || !next(stats.peak_live_bytes) || !next(stats.arenas) || !next(arenas_count)
+        || base % HEAP_ALIGN != 0 || arenas_count > (count - pos) / 2 || base + arenas_count * HEAP_ARENA_SIZE != memory.size())
+        return false;
+
+    arenas.resize(arenas_count);
+    for (Arena &arena: arenas) {
+        const uint64_t size_class = words[pos++];
+        arena.span = words[pos++];
+        if (size_class > CONTINUATION)
+            return false;
+
+        arena.size_class = static_cast<uint8_t>(size_class);
+    }
+
+    if (!next(live_count) || live_count != (arenas_count * HEAP_ARENA_SIZE / HEAP_ALIGN + 63) / 64 || live_count > count - pos)
+        return false;
+
+    live.assign(words + pos, words + pos + live_count);
+    pos += live_count;
+
+    // the addrs handed back by 'allocate' must be in the heap
+    const uint64_t end = base + arenas_count * HEAP_ARENA_SIZE;
+    const auto in_heap = [&](const uint64_t addr) { return addr >= base && addr <= end && addr % HEAP_ALIGN == 0; };
+
+    for (size_t i = 0; i < HEAP_SIZE_CLASSES; i++) {
+        uint64_t size;
+        if (!next(size) || size > count - pos)
+            return false;
+
+        free_lists[i].assign(words + pos, words + pos + size);
+        pos += size;
+        if (!next(bump[i]) || !next(bump_end[i]) || bump[i] > bump_end[i] || (bump_end[i] != 0 && (!in_heap(bump[i]) || !in_heap(bump_end[i]))))
+            return false;
+
+        for (const uint64_t addr: free_lists[i])
+            if (!in_heap(addr) || addr == end)
+                return false;
+    }
+
+    uint64_t large_count;
+    if (!next(large_count) || large_count > (count - pos) / 2)
+        return false;
+
+    free_large.resize(large_count);
+    for (auto &[addr, span]: free_large) {
+        addr = words[pos++];
+        span = words[pos++];
+        if (!in_heap(addr) || span > (end - addr) / HEAP_ARENA_SIZE)
+            return false;
+    }
+
+    return pos == count;
+}
+
+void Heap::dump_stats(std::ostream &os) const {
+    os << "Heap:" << std::endl;
+    os << "    allocations: " << stats.allocations << " (" << stats.failed_allocations << " failed)" << std::endl;
+    os << "    frees: " << stats.frees << " (" << stats.invalid_frees << " invalid)" << std::endl;
+    os << "    live bytes: " << stats.live_bytes << " (peak: " << stats.peak_live_bytes << ")" << std::endl;
+    os << "    arenas: " << stats.arenas << " (" << stats.arenas * HEAP_ARENA_SIZE << " bytes)" << std::endl;
+}
@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <fcntl.h>
+
+#include "io_queue.h"
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#ifdef _WIN32
+    #define close_fd _close
+#else
+    #define close_fd ::close
+#endif
+
+#ifdef HAS_IO_URING
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+#endif
+
+// 'pread'/'pwrite' for the requests done without io_uring
+static int64_t sync_request(const Io_Op op, const int fd, const uint64_t offset, uint8_t *const buffer, const size_t size) {
+#ifdef _WIN32
+    if (_lseeki64(fd, static_cast<int64_t>(offset), SEEK_SET) < 0)
+        return -errno;
+
+    const int done = op == IO_READ ? _read(fd, buffer, static_cast<unsigned>(size)) : _write(fd, buffer, static_cast<unsigned>(size));
+#else
+    const ssize_t done = op == IO_READ ? pread(fd, buffer, size, static_cast<off_t>(offset)) : pwrite(fd, buffer, size, static_cast<off_t>(offset));
+#endif
+    return done < 0 ? -errno : static_cast<int64_t>(done);
+}
+
+Io_Queue::Io_Queue() : in_flight(0), ring_tried(false), ring_fd(-1), sq_ring(nullptr), cq_ring(nullptr), sqes(nullptr), sq_ring_size(0), cq_ring_size(0), sqes_size(0) {}
+
+Io_Queue::~Io_Queue() {
+    reset();
+
+#ifdef HAS_IO_URING
+    if (ring_fd >= 0) {
+        munmap(sqes, sqes_size);
+        if (cq_ring != sq_ring)
+            munmap(cq_ring, cq_ring_size);
+        munmap(sq_ring, sq_ring_size);
+        close_fd(ring_fd);
+    }
+#endif
+}
+
+void Io_Queue::setup_ring() {
+    ring_tried = true;
+
+#ifdef HAS_IO_URING
+    // the ring is set up with the raw syscalls (no liburing), any failure (old kernel, seccomp, ...) just means no io_uring
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    const long fd = syscall(__NR_io_uring_setup, IO_QUEUE_ENTRIES, &params);
+    if (fd < 0)
+        return;
+
+    // 'IORING_OP_READ'/'IORING_OP_WRITE' came with this feature (Linux 5.6)
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close_fd(static_cast<int>(fd));
+        return;
+    }
+
+    ring_fd = static_cast<int>(fd);
+    sq_entries = params.sq_entries;
+    cq_entries = params.cq_entries;
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    // newer kernels map both rings with one mmap
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    cq_ring = single_mmap ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqes_size);
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+            munmap(cq_ring, cq_ring_size);
+        if (sq_ring != MAP_FAILED)
+            munmap(sq_ring, sq_ring_size);
+
+        close_fd(ring_fd);
+        ring_fd = -1;
+        sq_ring = cq_ring = sqes = nullptr;
+        return;
+    }
+
+    uint8_t *const sq = static_cast<uint8_t*>(sq_ring);
+    uint8_t *const cq = static_cast<uint8_t*>(cq_ring);
+    sq_head  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes     = cq + params.cq_off.cqes;
+#endif
+}
+
+int64_t Io_Queue::open(const std::string &path, const Io_Mode mode) {
+    int flags;
+    switch (mode) {
+    case IO_MODE_READ:       flags = O_RDONLY; break;
+    case IO_MODE_WRITE:      flags = O_WRONLY | O_CREAT | O_TRUNC; break;
+    case IO_MODE_READ_WRITE: flags = O_RDWR | O_CREAT; break;
+    default: return -EINVAL;
+    }
+
+#ifdef _WIN32
+    const int fd = _open(path.c_str(), flags | _O_BINARY, 0644);
+#else
+    const int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+#endif
+    if (fd < 0)
+        return -errno;
+
+    // the ring is only set up for the programs that use files
+    if (!ring_tried)
+        setup_ring();
+
+    // reuse the first closed handle
+    for (size_t handle = 0; handle < files.size(); handle++) {
+        if (files[handle] < 0) {
+            files[handle] = fd;
+            return static_cast<int64_t>(handle);
+        }
+    }
+
+    files.push_back(fd);
+    return static_cast<int64_t>(files.size() - 1);
+}
+
+int64_t Io_Queue::close(const int64_t handle) {
+    if (handle < 0 || static_cast<uint64_t>(handle) >= files.size() || files[static_cast<size_t>(handle)] < 0)
+        return -EBADF;
+
+    // the kernel might still be using the file, and the requests not sent yet fail (the fd could be reused by another file)
+    const int fd = files[static_cast<size_t>(handle)];
+    for (uint64_t id = 0; id < requests.size(); id++) {
+        Request &request = requests[id];
+        if (!request.used || request.fd != fd)
+            continue;
+
+        if (request.submitted) {
+            wait(id);
+        } else {
+            std::erase(queued, id);
+            request.submitted = true;
+            request.done = true;
+            request.result = -EBADF;
+        }
+    }
+
+    files[static_cast<size_t>(handle)] = -1;
+    return close_fd(fd) < 0 ? -errno : 0;
+}
+
+int64_t Io_Queue::queue(const Io_Op op, const int64_t handle, const uint64_t offset, const uint8_t *const data, const size_t size, const uint64_t tag) {
+    if (handle < 0 || static_cast<uint64_t>(handle) >= files.size() || files[static_cast<size_t>(handle)] < 0)
+        return -EBADF;
+
+    // the length of an io_uring request is 32 bits
+    if (size > UINT32_MAX)
+        return -EINVAL;
+
+    uint64_t id;
+    if (free_ids.empty()) {
+        id = requests.size();
+        requests.emplace_back();
+    } else {
+        id = free_ids.back();
+        free_ids.pop_back();
+    }
+
+    // the buffer keeps its capacity when the id is reused
+    Request &request = requests[id];
+    request.used = true;
+    request.submitted = false;
+    request.done = false;
+    request.op = op;
+    request.fd = files[static_cast<size_t>(handle)];
+    request.offset = offset;
+    request.tag = tag;
+    request.result = 0;
+    if (op == IO_WRITE)
+        request.buffer.assign(data, data + size);
+    else
+        request.buffer.resize(size);
+
+    queued.push_back(id);
+    return static_cast<int64_t>(id);
+}
+
+size_t Io_Queue::submit(const size_t wait) {
+    if (ring_fd < 0) {
+        // no io_uring, the requests are done right away
+        for (const uint64_t id: queued) {
+            Request &request = requests[id];
+            request.submitted = true;
+            request.done = true;
+            request.result = sync_request(request.op, request.fd, request.offset, request.buffer.data(), request.buffer.size());
+        }
+
+        const size_t submitted = queued.size();
+        queued.clear();
+        return submitted;
+    }
+
+#ifdef HAS_IO_URING
+    // fill the submission ring, without going over what the completion ring can hold (the finished requests make room)
+    reap();
+    const unsigned head = std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+    unsigned tail = *sq_tail;
+    size_t count = 0;
+
+    io_uring_sqe *const entries = static_cast<io_uring_sqe*>(sqes);
+    while (count < queued.size() && tail - head < sq_entries && in_flight < cq_entries) {
+        const uint64_t id = queued[count++];
+        Request &request = requests[id];
+
+        const unsigned index = tail & *sq_mask;
+        io_uring_sqe &sqe = entries[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = request.op == IO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe.fd = request.fd;
+        sqe.addr = reinterpret_cast<uint64_t>(request.buffer.data());
+        sqe.len = static_cast<uint32_t>(request.buffer.size());
+        sqe.off = request.offset;
+        sqe.user_data = id;
+
+        sq_array[index] = index;
+        request.submitted = true;
+        in_flight++;
+        tail++;
+    }
+
+    std::atomic_ref<unsigned>(*sq_tail).store(tail, std::memory_order_release);
+    queued.erase(queued.begin(), queued.begin() + static_cast<std::ptrdiff_t>(count));
+
+    // one syscall for all of them (and the wait, if any)
+    enter(static_cast<unsigned>(std::min(wait, in_flight)));
+    reap();
+    return count;
+#else
+    (void)wait;
+    return 0;
+#endif
+}
+
+bool Io_Queue::poll(const uint64_t id) {
+    if (!requests[id].done && ring_fd >= 0)
+        reap();
+
+    return requests[id].done;
+}
+
+void Io_Queue::wait(const uint64_t id) {
+    while (!requests[id].done) {
+        // the request (and the ones queued before it) is sent now
+        if (!requests[id].submitted) {
+            submit(0);
+            continue;
+        }
+
+        enter(1);
+        reap();
+    }
+}
+
+void Io_Queue::release(const uint64_t id) {
+    // a queued request is dropped (it was never sent to the kernel)
+    Request &request = requests[id];
+    if (!request.submitted)
+        std::erase(queued, id);
+    else if (!request.done)
+        wait(id);
+
+    request.used = false;
+    free_ids.push_back(id);
+}
+
+void Io_Queue::reset() {
+    // the kernel must be done with the buffers before they are freed
+    while (in_flight > 0) {
+        enter(static_cast<unsigned>(in_flight));
+        reap();
+    }
+
+    requests.clear();
+    free_ids.clear();
+    queued.clear();
+
+    for (const int fd: files)
+        if (fd >= 0)
+            close_fd(fd);
+
+    files.clear();
+}
+
+void Io_Queue::reap() {
+#ifdef HAS_IO_URING
+    if (ring_fd < 0)
+        return;
+
+    unsigned head = *cq_head;
+    const unsigned tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+
+    const io_uring_cqe *const entries = static_cast<const io_uring_cqe*>(cqes);
+    for (; head != tail; head++) {
+        const io_uring_cqe &cqe = entries[head & *cq_mask];
+        Request &request = requests[cqe.user_data];
+        request.done = true;
+        request.result = cqe.res;
+        in_flight--;
+    }
+
+    std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+#endif
+}
+
+void Io_Queue::enter(const unsigned min_complete) {
+#ifdef HAS_IO_URING
+    if (ring_fd < 0)
+        return;
+
+    // everything in the submission ring not taken by the kernel yet (normally all of it is taken by the first call)
+    const unsigned to_submit = *sq_tail - std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+    if (to_submit == 0 && min_complete == 0)
+        return;
+
+    const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    if (syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        // the kernel took none of the entries (it only takes them inside this call), so they are taken back and their requests fail
+        // (the requests it took before still complete, the callers that wait for them keep reaping)
+        const int64_t error = -errno;
+        const unsigned head = std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+        const io_uring_sqe *const entries = static_cast<const io_uring_sqe*>(sqes);
+        for (unsigned i = head; i != *sq_tail; i++) {
+            Request &request = requests[entries[sq_array[i & *sq_mask]].user_data];
+            request.done = true;
+            request.result = error;
+            in_flight--;
+        }
+
+        std::atomic_ref<unsigned>(*sq_tail).store(head, std::memory_order_release);
+    }
+#else
+    (void)min_complete;
+#endif
+}
@@ -1,10 +1,48 @@
-#include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <array>
+#include <deque>
+#include <memory>
 
 #include "lexer.h"
 #include "cout_colors.h"
 #include "inst.h"
+#include "mapped_file.h"
+
+// classes of the chars (a table instead of the 'ctype' functions, which depend on the locale and cannot take negative chars)
+enum : uint8_t {
+    CHAR_SPACE  = 1 << 0,
+    CHAR_DIGIT  = 1 << 1,
+    CHAR_ALPHA  = 1 << 2,
+    CHAR_NUMBER = 1 << 3, // the chars of a number: digits, '.', ',', '-' and 'e'
+    CHAR_WORD   = 1 << 4  // the chars of an instruction, keyword or label: letters, digits, '_' and ':'
+};
+
+static constexpr std::array<uint8_t, 256> char_classes = [] {
+    std::array<uint8_t, 256> classes {};
+    for (const char c: std::string_view(" \t\n\v\f\r"))
+        classes[static_cast<uint8_t>(c)] |= CHAR_SPACE;
+
+    for (size_t c = '0'; c <= '9'; c++)
+        classes[c] |= CHAR_DIGIT | CHAR_NUMBER | CHAR_WORD;
+
+    for (size_t c = 'a'; c <= 'z'; c++) {
+        classes[c] |= CHAR_ALPHA | CHAR_WORD;
+        classes[c - 'a' + 'A'] |= CHAR_ALPHA | CHAR_WORD;
+    }
+
+    for (const char c: std::string_view(".,-e"))
+        classes[static_cast<uint8_t>(c)] |= CHAR_NUMBER;
+
+    classes['_'] |= CHAR_WORD;
+    classes[':'] |= CHAR_WORD;
+    return classes;
+}();
+
+// the mapped source files (the tokens point into them), their paths and the strings of the tokens that are not in them
+static std::vector<std::shared_ptr<const Mapped_File>> source_files;
+static std::deque<std::string> source_paths;
+static std::deque<std::string> strings;
 
 void Lexer::get_errors() {
     for (Token &token: tokens) {
@@ -32,99 +70,135 @@ void Lexer::print_tokens() {
 }
 
 std::vector<Token> &Lexer::tokenize () {
-    // open the file
-    std::ifstream file(path, std::ios::in);
-    if (!file.is_open()) {
+    // map the file
+    std::shared_ptr<const Mapped_File> file = Mapped_File::open(path);
+    if (file == nullptr) {
         std::cerr << "ERROR: An error occured when while trying to read source code from '" << path << "'." << std::endl;
         exit(1);
     }
 
+    const std::string_view source(reinterpret_cast<const char*>(file->bytes().data()), file->bytes().size());
+    const uint32_t file_id = static_cast<uint32_t>(source_files.size());
+    source_files.push_back(std::move(file));
+    source_paths.emplace_back(path);
+
     size_t pos_start = 1;
     size_t line_number = 1;
-    while (std::getline(file, line)) {
+    for (size_t line_start = 0; line_start < source.size(); line_number++) {
+        const size_t line_end = std::min(source.find('\n', line_start), source.size());
+        line = source.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
         pos = 0;
         while (pos < line.size()) {
             pos_start = pos + 1;
+            const uint8_t c = static_cast<uint8_t>(line[pos]);
 
-            if (std::isspace(line[pos])) {
+            if (char_classes[c] & CHAR_SPACE) {
                 // handle spaces
                 pos++;
 
-            } else if (line[pos] == '#') {
+            } else if (c == '#') {
                 // handle comments
                 pos = line.size();
 
-            } else if (line[pos] == '%') {
+            } else if (c == '%') {
                 // handle preprocessor directives
                 pos++; // ignore the '%'
-                const std::string directive = read_while([](char c) { return !std::isspace(c); });
-                tokens.push_back({Token_Type::DIRECTIVE, std::move(directive), path, line_number, pos_start, false});
+                const std::string_view directive = read_while([](const uint8_t ch) { return !(char_classes[ch] & CHAR_SPACE); });
+                tokens.push_back({Token_Type::DIRECTIVE, directive, file_id, line_number, pos_start, false});
 
-            } else if (line[pos] == '"') {
+            } else if (c == '"') {
                 // handle string literals
                 bool broken = false;
-                const std::string str = read_string(broken);
-                tokens.push_back({Token_Type::STRING, std::move(str), path, line_number, pos_start, broken});
+                const std::string_view str = read_string(broken);
+                tokens.push_back({Token_Type::STRING, str, file_id, line_number, pos_start, broken});
 
-            } else if (std::isdigit(line[pos]) || line[pos] == '-') {
+            } else if (char_classes[c] & CHAR_DIGIT || c == '-') {
                 // handle numbers
-                std::string number = read_while([](char c) { return (c >= 48 && c <= 57) || c == '.' || c == ',' || c == '-' || c == 'e'; });
+                std::string_view number = read_while([](const uint8_t ch) { return char_classes[ch] & CHAR_NUMBER; });
 
                 // distinguish between integers and floating point
-                if (number.find('.') != std::string::npos || number.find(',') != std::string::npos || number.find('e') != std::string::npos) {
-                    std::replace(number.begin(), number.end(), ',', '.');
-                    tokens.push_back({Token_Type::FP, std::move(number), path, line_number, pos_start, false});
+                if (number.find_first_of(".,e") != std::string_view::npos) {
+                    if (number.find(',') != std::string_view::npos) {
+                        std::string fp(number);
+                        std::replace(fp.begin(), fp.end(), ',', '.');
+                        number = store(std::move(fp));
+                    }
+
+                    tokens.push_back({Token_Type::FP, number, file_id, line_number, pos_start, false});
                 } else {
-                    tokens.push_back({Token_Type::INTEGER, std::move(number), path, line_number, pos_start, false});
+                    tokens.push_back({Token_Type::INTEGER, number, file_id, line_number, pos_start, false});
                 }
 
-            } else if (std::isalpha(line[pos]) || line[pos] == '_') {
+            } else if (char_classes[c] & CHAR_ALPHA || c == '_') {
                 // handle instructions and labels
-                std::string word = read_while([](char c) { return std::isalnum(c) || c == '_' || c == ':'; });
+                std::string_view word = read_while([](const uint8_t ch) { return char_classes[ch] & CHAR_WORD; });
                 if (word.back() == ':') {
-                    word.pop_back();
-                    tokens.push_back({LABEL, std::move(word), path, line_number, pos_start, false});
+                    word.remove_suffix(1);
+                    tokens.push_back({LABEL, word, file_id, line_number, pos_start, false});
                 } else if (str_as_inst(word) != Inst_Type::INST_COUNT) {
-                    tokens.push_back({INSTRUCTION, std::move(word), path, line_number, pos_start, false});
+                    tokens.push_back({INSTRUCTION, word, file_id, line_number, pos_start, false});
                 } else {
-                    tokens.push_back({KEYWORD, std::move(word), path, line_number, pos_start, false});
+                    tokens.push_back({KEYWORD, word, file_id, line_number, pos_start, false});
                 }
 
             } else {
                 // handle unknown tokens
-                const std::string val = read_while([](char c) { return !std::isspace(c); });
-                tokens.push_back({UNKNOWN, std::move(val), path, line_number, pos_start, false});
+                const std::string_view val = read_while([](const uint8_t ch) { return !(char_classes[ch] & CHAR_SPACE); });
+                tokens.push_back({UNKNOWN, val, file_id, line_number, pos_start, false});
                 pos++;
             }
         }
-
-        line_number++;
     }
 
-    file.close();
     if (check_for_errors)
         get_errors();
 
     return tokens;
 }
 
-std::string Lexer::read_while(const std::function<bool(char)> &predicate) {
-    size_t start = pos;
-    while (pos < line.size() && predicate(line[pos])) {
+std::string_view Lexer::file_path(const uint32_t file_id) {
+    return source_paths[file_id];
+}
+
+std::string_view Lexer::store(std::string str) {
+    return strings.emplace_back(std::move(str));
+}
+
+template <typename Predicate>
+std::string_view Lexer::read_while(const Predicate predicate) {
+    const size_t start = pos;
+    while (pos < line.size() && predicate(static_cast<uint8_t>(line[pos]))) {
         pos++;
     }
     return line.substr(start, pos - start);
 }
 
-std::string Lexer::read_string(bool &broken) {
+std::string_view Lexer::read_string(bool &broken) {
     const size_t start = pos;
     pos++; // ignore the '"'
-    std::string str; // result string
 
+    // most strings have no escaped chars, they are used in place
+    const size_t end = line.find_first_of("\"\\", pos);
+    if (end != std::string_view::npos && line[end] == '"') {
+        pos = end + 1;
+        return line.substr(start + 1, end - start - 1);
+    }
+
+    std::string str; // result string
     while (pos < line.size() && line[pos] != '"') {
         if (line[pos] == '\\') {
             // handle escaped chars
             pos++;
+            if (pos + 1 >= line.size()) {
+                // handle unclosed string with escaping char at the end (the raw text is kept)
+                str.assign(line.begin() + static_cast<std::ptrdiff_t>(start), line.end());
+                broken = true;
+                pos = line.size();
+                break;
+            }
+
             switch (line[pos]) {
             case 'n':
                 str += '\n'; break;
@@ -144,16 +218,10 @@ std::string Lexer::read_string(bool &broken) {
             default:
                 str += line[pos]; break;
             }
-
-            if (pos == line.size() - 1) {
-                // handle unclosed string with escaping char at the end
-                str = line.substr(start, line.size() - 1);
-                broken = true;
-            }
         } else if (pos == line.size() - 1) {
             // handle unclosed string
             str += line[pos];
-            str.insert(0, "\"");
+            str.insert(str.begin(), '"');
             broken = true;
         } else {
             str += line[pos];
@@ -163,7 +231,7 @@ std::string Lexer::read_string(bool &broken) {
     }
 
     pos++;
-    return str;
+    return store(std::move(str));
 }
 
 const char *Lexer::type_as_cstr(Token_Type type) {
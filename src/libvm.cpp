@@ -0,0 +1,171 @@
+#include <new>
+
+#include "libvm.h"
+#include "vm.h"
+
+// the C handles are the C++ objects they stand for
+struct vm_image {
+    std::shared_ptr<const Image> image;
+};
+
+struct vm_snapshot {
+    std::shared_ptr<const Snapshot> snapshot;
+};
+
+struct vm_instance {
+    vm_instance(std::shared_ptr<const Image> image, size_t stack_cap) : vm(std::move(image), stack_cap) {}
+    Vm vm;
+};
+
+vm_image *vm_image_load(const void *const data, const size_t size) {
+    try {
+        Program program;
+        std::string error;
+        if (!program.read_from_memory(static_cast<const uint8_t*>(data), size, error))
+            return nullptr;
+
+        return new vm_image {std::make_shared<const Image>(std::move(program))};
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+// mapped and decoded in place, like the programs run by vme
+vm_image *vm_image_load_file(const char *const path) {
+    try {
+        std::string error;
+        std::shared_ptr<const Image> image = Image::load(path, error);
+        return image ? new vm_image {std::move(image)} : nullptr;
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+void vm_image_free(vm_image *const image) {
+    delete image;
+}
+
+vm_snapshot *vm_snapshot_load_file(const char *const path) {
+    try {
+        std::string error;
+        std::shared_ptr<const Snapshot> snapshot = Snapshot::load(path, error);
+        return snapshot ? new vm_snapshot {std::move(snapshot)} : nullptr;
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+void vm_snapshot_free(vm_snapshot *const snapshot) {
+    delete snapshot;
+}
+
+vm_instance *vm_create(const vm_image *const image, const size_t stack_cap) {
+    try {
+        return new vm_instance(image->image, stack_cap == 0 ? DEFAULT_STACK_CAP : stack_cap);
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+void vm_destroy(vm_instance *const vm) {
+    delete vm;
+}
+
+int vm_set_snapshot(vm_instance *const vm, const vm_snapshot *const snapshot) {
+    return vm->vm.set_snapshot(snapshot != nullptr ? snapshot->snapshot : nullptr);
+}
+
+void vm_set_fuel(vm_instance *const vm, const uint64_t fuel) {
+    vm->vm.set_fuel(fuel == 0 ? UNLIMITED_FUEL : fuel);
+}
+
+void vm_set_timeout(vm_instance *const vm, const uint64_t milliseconds) {
+    vm->vm.set_timeout(std::chrono::milliseconds(milliseconds));
+}
+
+void vm_interrupt(vm_instance *const vm) {
+    vm->vm.interrupt();
+}
+
+void vm_set_input(vm_instance *const vm, const char *const data, const size_t size) {
+    vm->vm.set_input(std::string_view(data, size));
+}
+
+void vm_capture_output(vm_instance *const vm, const int capture) {
+    vm->vm.get_output().set_capture(capture != 0);
+}
+
+const char *vm_output(vm_instance *const vm, size_t *const size) {
+    const std::string_view output = vm->vm.get_output().captured();
+    *size = output.size();
+    return output.data();
+}
+
+void vm_clear_output(vm_instance *const vm) {
+    vm->vm.get_output().clear();
+}
+
+void vm_clear_arguments(vm_instance *const vm) {
+    vm->vm.get_arguments().clear();
+}
+
+int vm_push_int(vm_instance *const vm, const int64_t value) {
+    try {
+        vm->vm.get_arguments().push_back(Nan_Box(value));
+        return 1;
+    } catch (const std::exception &) {
+        return 0;
+    }
+}
+
+int vm_push_double(vm_instance *const vm, const double value) {
+    try {
+        vm->vm.get_arguments().push_back(Nan_Box(value));
+        return 1;
+    } catch (const std::exception &) {
+        return 0;
+    }
+}
+
+// a run that cannot get its resources (the memory, the thread of the timeout) fails like the failed 'reset' of 'run'
+int vm_run(vm_instance *const vm) {
+    try {
+        return static_cast<int>(vm->vm.run());
+    } catch (const std::exception &) {
+        return static_cast<int>(Exception_Type::EXCEPTION_OUT_OF_MEMORY);
+    }
+}
+
+const char *vm_exception_name(const int exception) {
+    return exception_as_cstr(static_cast<Exception_Type>(exception));
+}
+
+size_t vm_result_count(const vm_instance *const vm) {
+    return vm->vm.get_results().size();
+}
+
+// 'index' 0 is the top of the stack
+static Nan_Box result(const vm_instance *const vm, const size_t index) {
+    const std::span<const Nan_Box> results = vm->vm.get_results();
+    return results[results.size() - 1 - index];
+}
+
+vm_value_type vm_result_type(const vm_instance *const vm, const size_t index) {
+    return static_cast<vm_value_type>(result(vm, index).get_type());
+}
+
+int64_t vm_result_int(const vm_instance *const vm, const size_t index) {
+    const Nan_Box value = result(vm, index);
+    return value.get_type() == Nan_Type::DOUBLE ? static_cast<int64_t>(value.as_double()) : value.as_int();
+}
+
+double vm_result_double(const vm_instance *const vm, const size_t index) {
+    const Nan_Box value = result(vm, index);
+    return value.get_type() == Nan_Type::DOUBLE ? value.as_double() : static_cast<double>(value.as_int());
+}
+
+const uint8_t *vm_memory(const vm_instance *const vm, size_t *const size) {
+    const Vm_Memory &memory = vm->vm.get_memory();
+    *size = memory.size();
+    return memory.data();
+}
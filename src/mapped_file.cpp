@@ -0,0 +1,58 @@
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+#include "mapped_file.h"
+
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+Mapped_File::~Mapped_File() {
+#ifndef _WIN32
+    if (mapped)
+        munmap(const_cast<void*>(contents), size);
+#endif
+}
+
+std::shared_ptr<const Mapped_File> Mapped_File::open(const char *path) {
+    std::shared_ptr<Mapped_File> file(new Mapped_File());
+
+#ifndef _WIN32
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        if (fd >= 0)
+            close(fd);
+
+        return nullptr;
+    }
+
+    file->size = static_cast<size_t>(info.st_size);
+    void *const mapping = file->size > 0 ? mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping != MAP_FAILED) {
+        file->contents = mapping;
+        file->mapped = true;
+        return file;
+    }
+
+    if (file->size > 0)
+        return nullptr;
+#endif
+
+    // no mapping, the whole file is read
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.is_open())
+        return nullptr;
+
+    const std::vector<char> bytes((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    file->words.resize((bytes.size() + 7) / 8);
+    std::copy(bytes.begin(), bytes.end(), reinterpret_cast<char*>(file->words.data()));
+    file->contents = file->words.data();
+    file->size = bytes.size();
+    return file;
+}
@@ -0,0 +1,135 @@
+#include <new>
+#include <atomic>
+#include <mutex>
+
+#include "memory_region.h"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #undef EXCEPTION_STACK_OVERFLOW // 'EXCEPTION_STACK_OVERFLOW' is a WinAPI macro and also a variant in the 'Exception_Type' enum
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #include <signal.h>
+    #include <string.h>
+#endif
+
+#ifndef MAP_NORESERVE
+    #define MAP_NORESERVE 0
+#endif
+
+size_t Memory_Region::page_size() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return static_cast<size_t>(info.dwPageSize);
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+#ifdef HAS_GUARD_PAGE_HANDLER
+// addrs of the guard pages currently in use (read from the signal handler, so no locks and no allocations)
+#define MAX_GUARD_PAGES 16384
+static std::atomic<uintptr_t> guard_pages[MAX_GUARD_PAGES];
+static struct sigaction previous_segv_action;
+static struct sigaction previous_bus_action;
+
+static void register_guard_page(const uintptr_t addr) {
+    for (std::atomic<uintptr_t> &slot: guard_pages) {
+        uintptr_t expected = 0;
+        if (slot.compare_exchange_strong(expected, addr))
+            return;
+    }
+
+    // no more free slots, overflows into this guard page will just crash the process (still no memory corruption)
+}
+
+static void unregister_guard_page(const uintptr_t addr) {
+    for (std::atomic<uintptr_t> &slot: guard_pages) {
+        uintptr_t expected = addr;
+        if (slot.compare_exchange_strong(expected, 0))
+            return;
+    }
+}
+
+static void guard_page_handler(int sig, siginfo_t *info, void *context) {
+    const uintptr_t page = reinterpret_cast<uintptr_t>(info->si_addr) & ~(static_cast<uintptr_t>(sysconf(_SC_PAGESIZE)) - 1);
+    for (const std::atomic<uintptr_t> &slot: guard_pages) {
+        if (slot.load(std::memory_order_relaxed) == page) {
+            // same message as 'exception_handler' (only async-signal-safe functions can be used here)
+            const char msg[] = "ERROR: Exception occured 'EXCEPTION_STACK_OVERFLOW'\n";
+            const ssize_t written = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+            (void) written;
+            _exit(1);
+        }
+    }
+
+    // not one of our guard pages, let the previous handler (or the default action) deal with it
+    const struct sigaction &previous_action = sig == SIGSEGV ? previous_segv_action : previous_bus_action;
+    if (previous_action.sa_flags & SA_SIGINFO) {
+        previous_action.sa_sigaction(sig, info, context);
+    } else if (previous_action.sa_handler != SIG_DFL && previous_action.sa_handler != SIG_IGN) {
+        previous_action.sa_handler(sig);
+    } else {
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+}
+
+#endif
+
+void Memory_Region::catch_guard_page_faults() {
+#ifdef HAS_GUARD_PAGE_HANDLER
+    static std::once_flag installed;
+    std::call_once(installed, []() {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = guard_page_handler;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+
+        sigaction(SIGSEGV, &action, &previous_segv_action);
+    #ifdef __APPLE__
+        // macOS reports accesses to 'PROT_NONE' pages as 'SIGBUS'
+        sigaction(SIGBUS, &action, &previous_bus_action);
+    #endif
+    });
+#endif
+}
+
+Memory_Region::Memory_Region(const size_t size) {
+    const size_t page = page_size();
+    usable_size = (size + page - 1) / page * page;
+
+#ifdef _WIN32
+    // reserve everything, commit only the usable part (windows only backs the pages with memory when they are touched)
+    base = VirtualAlloc(nullptr, usable_size + page, MEM_RESERVE, PAGE_NOACCESS);
+    if (base == nullptr || VirtualAlloc(base, usable_size, MEM_COMMIT, PAGE_READWRITE) == nullptr) {
+        if (base != nullptr)
+            VirtualFree(base, 0, MEM_RELEASE);
+        throw std::bad_alloc();
+    }
+#else
+    base = mmap(nullptr, usable_size + page, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        throw std::bad_alloc();
+
+    if (mprotect(base, usable_size, PROT_READ | PROT_WRITE) != 0) {
+        munmap(base, usable_size + page);
+        throw std::bad_alloc();
+    }
+
+    register_guard_page(reinterpret_cast<uintptr_t>(base) + usable_size);
+#endif
+}
+
+Memory_Region::~Memory_Region() {
+#ifdef _WIN32
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    unregister_guard_page(reinterpret_cast<uintptr_t>(base) + usable_size);
+    munmap(base, usable_size + page_size());
+#endif
+}
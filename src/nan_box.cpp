@@ -1,14 +1,9 @@
 #include <iostream>
 #include <stdint.h>
-#include <math.h>
-#include <limits>
 
 #include "nan_box.h"
 
-#define TYPE_MASK (((1ULL << 3ULL) - 1ULL) << 48ULL)
-#define VALUE_MASK ((1ULL << 48ULL) - 1ULL)
-
-/*void Nan_Box::print_bits_representation(uint8_t *const ptr, const size_t size) {
+/*void Basic_Box::print_bits_representation(uint8_t *const ptr, const size_t size) {
     for (const uint8_t* ptr_end = ptr + size - 1; ptr_end >= ptr; ptr_end--) {
         for (char i = 7; i >= 0; i--) {
             std::cout << ((*ptr_end >> i) & 0x1);
@@ -18,54 +13,20 @@
     std::cout << std::endl;
 }*/
 
-Nan_Type Nan_Box::get_type() const {
-    if (!isnan(m_value))
-        return Nan_Type::DOUBLE;
-
-    const uint64_t *const value_ptr = (uint64_t*)(&m_value);
-    return (Nan_Type) ((*value_ptr & TYPE_MASK) >> 48ULL);
-}
-
-void Nan_Box::set_type(const Nan_Type type) {
-    m_value = std::numeric_limits<double>::quiet_NaN(); // make a nan
-    uint64_t *const value_ptr = (uint64_t*)(&this->m_value);
-    *value_ptr = (*value_ptr & ~TYPE_MASK) | ((uint64_t)type << 48ULL);
-}
-
-uint64_t Nan_Box::get_value() const {
-    const uint64_t *const value_ptr = (uint64_t*)(&m_value);
-    uint64_t new_value = *value_ptr & VALUE_MASK;
-
-    // new_value |= (0xFFFF000000000000 * (new_value >> 47ULL) * (this->get_type() == Nan_Type::INT));
-    if (this->get_type() == Nan_Type::INT) {
-        // sign extend the value
-        const uint64_t sign_bit = new_value >> 47ULL;
-        if (sign_bit == 1) {
-            new_value |= 0xFFFF000000000000;
-        }
-    }
-
-    return new_value;
-}
-
-void Nan_Box::set_value(const uint64_t value) {
-    uint64_t *const value_ptr = (uint64_t*)(&this->m_value);
-    *value_ptr |= value & VALUE_MASK;
-}
-
-// operator overloading
+// generic versions of the operators (see the inline ones in the header)
 
-Nan_Box& Nan_Box::operator+=(Nan_Box& rhs) {
+template <typename Encoding>
+Basic_Box<Encoding>& Basic_Box<Encoding>::add_generic(Basic_Box& rhs) {
     const Nan_Type type = this->get_type();
     const Nan_Type rhs_type = rhs.get_type();
 
     if (type == Nan_Type::DOUBLE) {
         if (rhs_type == Nan_Type::DOUBLE) {
             // sum of two doubles
-            m_value += rhs.as_double();
+            this->box_double(this->as_double() + rhs.as_double());
         } else if (rhs_type == Nan_Type::INT) {
             // sum of a double and an int
-            this->m_value += static_cast<double>(rhs.as_int());
+            this->box_double(this->as_double() + static_cast<double>(rhs.as_int()));
         } else if (rhs_type == Nan_Type::PTR) {
             // return an exception (cannot add a pointer and a double)
             this->box_exception(Exception_Type::EXCEPTION_ADD_POINTER_AND_DOUBLE);
@@ -97,17 +58,18 @@ Nan_Box& Nan_Box::operator+=(Nan_Box& rhs) {
     return *this;
 }
 
-Nan_Box& Nan_Box::operator-=(Nan_Box& rhs) {
+template <typename Encoding>
+Basic_Box<Encoding>& Basic_Box<Encoding>::sub_generic(Basic_Box& rhs) {
     const Nan_Type type = this->get_type();
     const Nan_Type rhs_type = rhs.get_type();
 
     if (type == Nan_Type::DOUBLE) {
         if (rhs_type == Nan_Type::DOUBLE) {
             // subtract two doubles
-            m_value -= rhs.as_double();
+            this->box_double(this->as_double() - rhs.as_double());
         } else if (rhs_type == Nan_Type::INT) {
             // subtract an int from a double
-            this->m_value -= static_cast<double>(rhs.as_int());
+            this->box_double(this->as_double() - static_cast<double>(rhs.as_int()));
         } else if (rhs_type == Nan_Type::PTR) {
             // return an exception (cannot subtract a pointer and a double)
             this->box_exception(Exception_Type::EXCEPTION_SUBTRACT_POINTER_AND_DOUBLE);
@@ -139,17 +101,18 @@ Nan_Box& Nan_Box::operator-=(Nan_Box& rhs) {
     return *this;
 }
 
-Nan_Box& Nan_Box::operator*=(Nan_Box& rhs) {
+template <typename Encoding>
+Basic_Box<Encoding>& Basic_Box<Encoding>::mul_generic(Basic_Box& rhs) {
     const Nan_Type type = this->get_type();
     const Nan_Type rhs_type = rhs.get_type();
 
     if (type == Nan_Type::DOUBLE) {
         if (rhs_type == Nan_Type::DOUBLE) {
             // multiply two doubles
-            m_value *= rhs.as_double();
+            this->box_double(this->as_double() * rhs.as_double());
         } else if (rhs_type == Nan_Type::INT) {
             // multiply a double and an int
-            this->m_value *= static_cast<double>(rhs.as_int());
+            this->box_double(this->as_double() * static_cast<double>(rhs.as_int()));
         } else if (rhs_type == Nan_Type::PTR) {
             // return an exception (cannot multiply a pointer and a double)
             this->box_exception(Exception_Type::EXCEPTION_MUL_POINTER);
@@ -173,7 +136,8 @@ Nan_Box& Nan_Box::operator*=(Nan_Box& rhs) {
     return *this;
 }
 
-Nan_Box& Nan_Box::operator/=(Nan_Box& rhs) {
+template <typename Encoding>
+Basic_Box<Encoding>& Basic_Box<Encoding>::div_generic(Basic_Box& rhs) {
     const Nan_Type type = this->get_type();
     const Nan_Type rhs_type = rhs.get_type();
 
@@ -183,14 +147,14 @@ Nan_Box& Nan_Box::operator/=(Nan_Box& rhs) {
                 // return an exception (cannot divide by 0)
                 this->box_exception(Exception_Type::EXCEPTION_DIV_BY_ZERO);
             } else {
-                m_value /= rhs.as_double();
+                this->box_double(this->as_double() / rhs.as_double());
             }
         } else if (rhs_type == Nan_Type::INT) {
             if (rhs.as_int() == 0) {
                 // return an exception (cannot divide by 0)
                 this->box_exception(Exception_Type::EXCEPTION_DIV_BY_ZERO);
             } else {
-                this->m_value /= static_cast<double>(rhs.as_int());
+                this->box_double(this->as_double() / static_cast<double>(rhs.as_int()));
             }
         } else if (rhs_type == Nan_Type::PTR) {
             // return an exception (cannot divide a double by a pointer)
@@ -227,91 +191,8 @@ Nan_Box& Nan_Box::operator/=(Nan_Box& rhs) {
     return *this;
 }
 
-Nan_Box& Nan_Box::operator%=(Nan_Box& rhs) {
-    const Nan_Type type = this->get_type();
-    const Nan_Type rhs_type = rhs.get_type();
-
-    if (type != Nan_Type::INT || rhs_type != Nan_Type::INT)
-        this->box_exception(Exception_Type::EXCEPTION_MODULO_NON_INT);
-    else
-        this->box_int(this->as_int() % rhs.as_int());
-
-    return *this;
-}
-
-Nan_Box& Nan_Box::operator<<=(Nan_Box& rhs) {
-    const Nan_Type type = this->get_type();
-    const Nan_Type rhs_type = rhs.get_type();
-
-    if (type != Nan_Type::INT || rhs_type != Nan_Type::INT)
-        this->box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
-    else
-        this->box_int(this->as_int() << rhs.as_int());
-
-    return *this;
-}
-
-// arithmetic shift
-Nan_Box& Nan_Box::operator>>=(Nan_Box& rhs) {
-    const Nan_Type type = this->get_type();
-    const Nan_Type rhs_type = rhs.get_type();
-
-    if (type != Nan_Type::INT || rhs_type != Nan_Type::INT)
-        this->box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
-    else
-        this->box_int(this->as_int() >> rhs.as_int());
-
-    return *this;
-}
-
-Nan_Box& Nan_Box::operator&=(Nan_Box& rhs) {
-    const Nan_Type type = this->get_type();
-    const Nan_Type rhs_type = rhs.get_type();
-
-    if (type != Nan_Type::INT || rhs_type != Nan_Type::INT)
-        this->box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
-    else
-        this->box_int(this->as_int() & rhs.as_int());
-
-    return *this;
-}
-
-Nan_Box& Nan_Box::operator|=(Nan_Box& rhs) {
-    const Nan_Type type = this->get_type();
-    const Nan_Type rhs_type = rhs.get_type();
-
-    if (type != Nan_Type::INT || rhs_type != Nan_Type::INT)
-        this->box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
-    else
-        this->box_int(this->as_int() | rhs.as_int());
-
-    return *this;
-}
-
-Nan_Box& Nan_Box::operator^=(Nan_Box& rhs) {
-    const Nan_Type type = this->get_type();
-    const Nan_Type rhs_type = rhs.get_type();
-
-    if (type != Nan_Type::INT || rhs_type != Nan_Type::INT)
-        this->box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
-    else
-        this->box_int(this->as_int() ^ rhs.as_int());
-
-    return *this;
-}
-
-Nan_Box& Nan_Box::operator~() {
-    const Nan_Type type = this->get_type();
-
-    if (type != Nan_Type::INT)
-        this->box_exception(Exception_Type::EXCEPTION_BITWISE_NON_INT);
-    else
-        this->box_int(~this->as_int());
-
-    return *this;
-}
-
-bool Nan_Box::operator==(Nan_Box& rhs) {
+template <typename Encoding>
+bool Basic_Box<Encoding>::equals_generic(Basic_Box& rhs) {
     const Nan_Type type = this->get_type();
     const Nan_Type rhs_type = rhs.get_type();
 
@@ -328,3 +209,6 @@ bool Nan_Box::operator==(Nan_Box& rhs) {
     // this should never happen
     return false;
 }
+
+template class Basic_Box<Nan_Encoding>;
+template class Basic_Box<Int_Encoding>;
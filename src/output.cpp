@@ -0,0 +1,234 @@
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+
+#include "output.h"
+
+#ifdef _WIN32
+    #include <io.h>
+
+    // there is no 'writev', the buffers are written one by one
+    struct iovec {
+        void  *iov_base;
+        size_t iov_len;
+    };
+#else
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+
+// writes all the buffers (retrying after partial writes and interruptions)
+static void write_vectors(const int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+#ifdef _WIN32
+        const long long written = _write(fd, iov->iov_base, static_cast<unsigned int>(iov->iov_len));
+#else
+        const ssize_t written = ::writev(fd, iov, count);
+#endif
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return; // nothing else can be done (like with a closed pipe)
+        }
+
+        // skip what was written
+        size_t left = static_cast<size_t>(written);
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+}
+
+static bool is_terminal(const int fd) {
+#ifdef _WIN32
+    return _isatty(fd);
+#else
+    return isatty(fd);
+#endif
+}
+
+Output::Output(const int fd) : Output(fd, is_terminal(fd) ? Flush_Policy::LINE : Flush_Policy::SIZE) {}
+
+Output::Output(const int fd, const Flush_Policy policy) : fd(fd), policy(policy), head(0), tail(0), background(false), capture(false), stopping(false) {
+    for (std::vector<char> &buffer: buffers)
+        buffer.reserve(OUTPUT_BUFFER_SIZE);
+}
+
+Output::~Output() {
+    set_background(false);
+    flush();
+}
+
+void Output::set_policy(const Flush_Policy policy) {
+    this->policy = policy;
+}
+
+void Output::set_capture(const bool capture) {
+    if (capture)
+        set_background(false);
+
+    this->capture = capture;
+}
+
+void Output::set_background(const bool background) {
+    if (background == this->background || (background && capture))
+        return;
+
+    if (background) {
+        stopping.store(false, std::memory_order_relaxed);
+        writer = std::thread(&Output::writer_loop, this);
+        this->background = true;
+        return;
+    }
+
+    // the writer stops once it has written everything published before 'stopping' was set (the empty buffer published
+    // after it only wakes the writer up)
+    flush();
+    stopping.store(true, std::memory_order_release);
+    current().clear();
+    head.fetch_add(1, std::memory_order_release);
+    head.notify_one();
+
+    writer.join();
+    this->background = false;
+    current().clear(); // the next buffer still has what was written the last time it was used
+
+}
+
+void Output::write(const char *data, const size_t size) {
+    std::vector<char> &buffer = current();
+    if (capture) {
+        buffer.insert(buffer.end(), data, data + size);
+        return;
+    }
+
+    // a big write goes out together with the buffer (no copy)
+    if (!background && policy != Flush_Policy::EXIT && buffer.size() + size > OUTPUT_BUFFER_SIZE) {
+        struct iovec iov[2] = {
+            {buffer.data(), buffer.size()},
+            {const_cast<char*>(data), size}
+        };
+        write_vectors(fd, iov, 2);
+        buffer.clear();
+        return;
+    }
+
+    buffer.insert(buffer.end(), data, data + size);
+
+    switch (policy) {
+    case Flush_Policy::LINE:
+        if (std::memchr(data, '\n', size) != nullptr)
+            flush();
+        break;
+
+    case Flush_Policy::SIZE:
+        if (buffer.size() >= OUTPUT_BUFFER_SIZE)
+            flush();
+        break;
+
+    case Flush_Policy::EXIT:
+    default:
+        break;
+    }
+}
+
+void Output::write_int(const int64_t value) {
+    char buf[24];
+    const std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), value);
+    write(buf, static_cast<size_t>(result.ptr - buf));
+}
+
+void Output::write_double(const double value) {
+    char buf[32];
+    const std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general, 6);
+    write(buf, static_cast<size_t>(result.ptr - buf));
+}
+
+void Output::write_ptr(const uint64_t value) {
+    // like 'std::showbase', zero has no prefix
+    if (value == 0) {
+        put('0');
+        return;
+    }
+
+    char buf[24] = {'0', 'x'};
+    const std::to_chars_result result = std::to_chars(buf + 2, buf + sizeof(buf), value, 16);
+    write(buf, static_cast<size_t>(result.ptr - buf));
+}
+
+void Output::flush() {
+    std::vector<char> &buffer = current();
+    if (buffer.empty() || capture)
+        return;
+
+    if (!background) {
+        struct iovec iov = {buffer.data(), buffer.size()};
+        write_vectors(fd, &iov, 1);
+        buffer.clear();
+        return;
+    }
+
+    // hand the buffer to the writer
+    const uint64_t published = head.fetch_add(1, std::memory_order_release) + 1;
+    head.notify_one();
+
+    // wait until the next buffer is free (only when all of them are in flight)
+    uint64_t written = tail.load(std::memory_order_acquire);
+    while (published - written >= OUTPUT_RING_SIZE) {
+        tail.wait(written, std::memory_order_acquire);
+        written = tail.load(std::memory_order_acquire);
+    }
+
+    current().clear();
+}
+
+void Output::sync() {
+    flush();
+    if (!background)
+        return;
+
+    const uint64_t published = head.load(std::memory_order_relaxed);
+    uint64_t written = tail.load(std::memory_order_acquire);
+    while (written != published) {
+        tail.wait(written, std::memory_order_acquire);
+        written = tail.load(std::memory_order_acquire);
+    }
+}
+
+void Output::writer_loop() {
+    uint64_t written = tail.load(std::memory_order_relaxed);
+
+    for (;;) {
+        const uint64_t published = head.load(std::memory_order_acquire);
+        if (published == written) {
+            // 'head' is loaded again after 'stopping': the last buffer might have been published after the first load
+            if (stopping.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == written)
+                return;
+
+            head.wait(published, std::memory_order_acquire);
+            continue;
+        }
+
+        // all the buffers in the ring go out with a single 'writev'
+        struct iovec iov[OUTPUT_RING_SIZE];
+        int count = 0;
+        for (uint64_t i = written; i != published; i++) {
+            std::vector<char> &buffer = buffers[i % OUTPUT_RING_SIZE];
+            if (!buffer.empty())
+                iov[count++] = {buffer.data(), buffer.size()};
+        }
+        write_vectors(fd, iov, count);
+
+        written = published;
+        tail.store(written, std::memory_order_release);
+        tail.notify_one();
+    }
+}
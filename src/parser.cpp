@@ -1,5 +1,8 @@
 // #include <iostream>
 
+#include <algorithm>
+#include <charconv>
+
 #include "parser.h"
 #include "directive.h"
 // #include "inst.h"
@@ -7,15 +10,15 @@
 
 #define Includes  (parent == nullptr ? includes : parent->includes)
 #define Insts     (parent == nullptr ? insts : parent->insts)
-#define Labels    (parent == nullptr ? labels : parent->labels)
-#define UnRLabels (parent == nullptr ? unresolved_labels : parent->unresolved_labels)
-#define Alias     (parent == nullptr ? alias : parent->alias)
+#define Symbols   (parent == nullptr ? symbols : parent->symbols)
+#define Fixups    (parent == nullptr ? fixups : parent->fixups)
 #define Memory    (parent == nullptr ? memory : parent->memory)
+#define Bss       (parent == nullptr ? bss_size : parent->bss_size)
 
-Parser::Parser(std::vector<Token> &tokens, Parser *parent) : pos(0), tokens(tokens), parent(parent) {
+Parser::Parser(std::vector<Token> &tokens, Parser *parent) : pos(0), tokens(tokens), bss_size(0), parent(parent) {
     // save the file path of the current file
     if (tokens.size() > 0) {
-        Includes.insert(tokens[0].file_path);
+        Includes.insert(std::string(Lexer::file_path(tokens[0].file_id)));
         Insts.reserve(static_cast<size_t>(tokens.size() / 2)); // rough estimation of how many instructions we have
     }
 }
@@ -47,19 +50,31 @@ void Parser::parse(Program *p) {
     }
 
     if (parent == nullptr) {
-        // second pass to resolve the remaining labels
-        for (Unresolved_Label &ul: unresolved_labels) {
-            if (!labels.contains(ul.token.value)) {
-                std::cerr << "ERROR: " << ul.token.file_path << ":" << ul.token.line_number << ":" << ul.token.line_offset << ": Unresolved label \"" << ul.token.value << "\"." << std::endl;
+        // patch the uses of the labels defined after them (one pass, the symbols are found by id)
+        for (const Label_Fixup &fixup: fixups) {
+            const Symbol &symbol = symbols[fixup.symbol];
+            if (symbol.kind != SYMBOL_LABEL) {
+                std::cerr << "ERROR: " << Lexer::file_path(fixup.token.file_id) << ":" << fixup.token.line_number << ":" << fixup.token.line_offset << ": Unresolved label \"" << fixup.token.value << "\"." << std::endl;
                 std::exit(1);
             }
 
-            insts[ul.inst_idx].operand.box_ptr(labels[ul.token.value].points_to);
+            insts[fixup.inst_idx].operand = symbol.value;
+        }
+
+        // the names of the labels (kept in the '.vm' file for the disassembler), in the order of the code
+        p->symbols.clear();
+        for (const Symbol &symbol: symbols.all()) {
+            if (symbol.kind == SYMBOL_LABEL)
+                p->symbols.emplace_back(symbol.name, reinterpret_cast<uint64_t>(symbol.value.as_ptr()));
         }
+        std::sort(p->symbols.begin(), p->symbols.end(), [](const auto &a, const auto &b) {
+            return a.second != b.second ? a.second < b.second : a.first < b.first;
+        });
 
         // move all the data to the program
-        p->insts  = std::move(insts);
-        p->memory = std::move(memory);
+        p->insts    = std::move(insts);
+        p->memory   = std::move(memory);
+        p->bss_size = bss_size;
     }
 }
 
@@ -76,17 +91,26 @@ void Parser::parse_inst() {
 }
 
 void Parser::parse_label() {
-    // check for duplicate label definition
-    if (Labels.contains(tokens[pos].value)) {
-        const Token *const tk = Labels[tokens[pos].value].token;
-        std::cerr << "ERROR: Label \"" << tokens[pos].value << "\" was redefined." << std::endl;
-        std::cerr << "\tInitially defined at " << tk->file_path << ":" << tk->line_number << ":" << tk->line_offset << "." << std::endl;
-        std::cerr << "\tRedefined at " << tokens[pos].file_path << ":" << tokens[pos].line_number << ":" << tokens[pos].line_offset << "." << std::endl;
+    const size_t l_size = parent == nullptr ? insts.size() : parent->insts.size();
+    define(tokens[pos], SYMBOL_LABEL, Token_Type::KEYWORD, Nan_Box((void *)l_size));
+}
+
+void Parser::define(const Token &name, const Symbol_Kind kind, const Token_Type type, const Nan_Box value) {
+    Symbol &symbol = Symbols[Symbols.intern(name.value)];
+
+    // check for duplicate definitions (labels and aliases share the names)
+    if (symbol.kind != SYMBOL_UNDEFINED) {
+        const Token &tk = symbol.definition;
+        std::cerr << "ERROR: " << (kind == SYMBOL_LABEL ? "Label" : "Alias") << " \"" << name.value << "\" was redefined." << std::endl;
+        std::cerr << "\tInitially defined at " << Lexer::file_path(tk.file_id) << ":" << tk.line_number << ":" << tk.line_offset << "." << std::endl;
+        std::cerr << "\tRedefined at " << Lexer::file_path(name.file_id) << ":" << name.line_number << ":" << name.line_offset << "." << std::endl;
         std::exit(1);
     }
 
-    const size_t l_size = parent == nullptr ? insts.size() : parent->insts.size();
-    Labels[tokens[pos].value] = Label {(void *)l_size, &tokens[pos]};
+    symbol.kind = kind;
+    symbol.type = type;
+    symbol.value = value;
+    symbol.definition = name;
 }
 
 void Parser::parse_directive() {
@@ -95,27 +119,21 @@ void Parser::parse_directive() {
         const Token &name  = next(dir_acc_tk[ALIAS][0], sizeof(dir_acc_tk[ALIAS][0]) / sizeof(dir_acc_tk[ALIAS][0][0]), true);
         const Token &value = next(dir_acc_tk[ALIAS][1], sizeof(dir_acc_tk[ALIAS][1]) / sizeof(dir_acc_tk[ALIAS][1][0]));
 
-        if (Alias.contains(name.value)) {
-            const Token &na = Alias[name.value];
-            std::cerr << "ERROR: Alias \"" << name.value << "\" was redefined." << std::endl;
-            std::cerr << "\tInitially defined at " << na.file_path << ":" << na.line_number << ":" << na.line_offset << "." << std::endl;
-            std::cerr << "\tRedefined at " << value.file_path << ":" << value.line_number << ":" << value.line_offset << "." << std::endl;
-            std::exit(1);
-        }
-
-        Alias[name.value] = value;
+        // the value is resolved once, the uses of the alias only copy it
+        define(name, SYMBOL_ALIAS, value.type, token_as_Nan_Box(value));
         break;
     }
 
     case Directive_Type::INCLUDE: {
         const Token &include_path = next(dir_acc_tk[INCLUDE][0], sizeof(dir_acc_tk[INCLUDE][0]) / sizeof(dir_acc_tk[INCLUDE][0][0]));
 
-        Lexer lexer(include_path.value.c_str());
+        const std::string include_file(include_path.value);
+        Lexer lexer(include_file.c_str());
         std::vector<Token> &new_tokens = lexer.tokenize();
 
-        if (new_tokens.size() > 0 && Includes.find(new_tokens[0].file_path) != includes.end()) {
+        if (new_tokens.size() > 0 && Includes.find(std::string(Lexer::file_path(new_tokens[0].file_id))) != includes.end()) {
             // file was already included
-            std::cerr << "ERROR: Circular file inclusion detected. The file \"" << new_tokens[0].file_path << "\" was included more than once." << std::endl;
+            std::cerr << "ERROR: Circular file inclusion detected. The file \"" << Lexer::file_path(new_tokens[0].file_id) << "\" was included more than once." << std::endl;
             std::exit(1);
         }
 
@@ -129,17 +147,15 @@ void Parser::parse_directive() {
         const Token &name  = next(dir_acc_tk[STR][0], sizeof(dir_acc_tk[STR][0]) / sizeof(dir_acc_tk[STR][0][0]), true);
         const Token &value = next(dir_acc_tk[STR][1], sizeof(dir_acc_tk[STR][1]) / sizeof(dir_acc_tk[STR][1][0]));
 
+        // the zero-filled blocks reserved before the string must be stored before it
+        Memory.resize(Memory.size() + Bss, 0);
+        Bss = 0;
+
         // save the addr of the string as an alias
-        Token addr = name;
-        addr.value = std::to_string(Memory.size());
-        addr.type = Token_Type::INTEGER;
-        Alias[name.value] = std::move(addr);
-
-        // save the string the the memory
-        Memory.reserve(value.value.size());
-        for (const char &c: value.value) {
-            Memory.push_back(Nan_Box(static_cast<int64_t>(c)));
-        }
+        define(name, SYMBOL_ALIAS, Token_Type::INTEGER, Nan_Box(static_cast<int64_t>(Memory.size())));
+
+        // save the string the the memory (one byte per char)
+        Memory.insert(Memory.end(), value.value.begin(), value.value.end());
 
         break;
     }
@@ -149,52 +165,53 @@ void Parser::parse_directive() {
         const Token &value = next(dir_acc_tk[RES][1], sizeof(dir_acc_tk[RES][1]) / sizeof(dir_acc_tk[RES][1][0]));
 
         // check the reserve size
-        const int64_t size = std::strtoll(value.value.c_str(), nullptr, 10);
+        int64_t size = 0;
+        std::from_chars(value.value.data(), value.value.data() + value.value.size(), size);
         if (size <= 0) {
-            std::cerr << "ERROR: " << value.file_path << ":" << value.line_number << ":" << value.line_offset << ": Can only reserve an amount of memory positive and bigger than 0;" << std::endl;
+            std::cerr << "ERROR: " << Lexer::file_path(value.file_id) << ":" << value.line_number << ":" << value.line_offset << ": Can only reserve an amount of memory positive and bigger than 0;" << std::endl;
             std::exit(1);
         }
 
         // save the addr of the memory block as an alias
-        Token addr = name;
-        addr.value = std::to_string(Memory.size());
-        addr.type = Token_Type::INTEGER;
-        Alias[name.value] = std::move(addr);
-
-        // zero initialize the memory block
-        Memory.reserve(static_cast<size_t>(size));
-        for (size_t i = 0; i < static_cast<size_t>(size); i++) {
-            Memory.push_back(Nan_Box(static_cast<int64_t>(0)));
-        }
+        define(name, SYMBOL_ALIAS, Token_Type::INTEGER, Nan_Box(static_cast<int64_t>(Memory.size() + Bss)));
+
+        // the memory block ('size' zero bytes) is only counted, it is stored in the '.vm' file as a size (see 'Program::bss_size')
+        Bss += static_cast<uint64_t>(size);
 
         break;
     }
 
     case Directive_Type::COUNT:
     default:
-        std::cerr << "ERROR: " << tokens[pos].file_path << ":" << tokens[pos].line_number << ":" << tokens[pos].line_offset << ": Unknown directive \"" << tokens[pos].value << "\"." << std::endl;
+        std::cerr << "ERROR: " << Lexer::file_path(tokens[pos].file_id) << ":" << tokens[pos].line_number << ":" << tokens[pos].line_offset << ": Unknown directive \"" << tokens[pos].value << "\"." << std::endl;
         std::exit(1);
     }
 }
 
 Nan_Box Parser::token_as_Nan_Box(const Token &token) {
     switch (token.type) {
-        case Token_Type::INTEGER:
-            return Nan_Box(static_cast<int64_t>(std::strtoll(token.value.c_str(), nullptr, 10)));
+        case Token_Type::INTEGER: {
+            int64_t value = 0;
+            std::from_chars(token.value.data(), token.value.data() + token.value.size(), value);
+            return Nan_Box(value);
+        }
 
-        case Token_Type::FP:
-            return Nan_Box(std::strtod(token.value.c_str(), nullptr));
+        case Token_Type::FP: {
+            double value = 0;
+            std::from_chars(token.value.data(), token.value.data() + token.value.size(), value);
+            return Nan_Box(value);
+        }
 
-        case Token_Type::KEYWORD:
-            if (Alias.contains(token.value)) {
-                return token_as_Nan_Box(Alias[token.value]);
-            } else if (Labels.contains(token.value)) {
-                return Nan_Box(Labels[token.value].points_to);
-            } else {
-                UnRLabels.push_back(Unresolved_Label {Insts.size(), token});
-            }
+        case Token_Type::KEYWORD: {
+            const uint32_t id = Symbols.intern(token.value);
+            const Symbol &symbol = Symbols[id];
+            if (symbol.kind != SYMBOL_UNDEFINED)
+                return symbol.value;
 
+            // a label defined later (patched at the end of the parsing)
+            Fixups.push_back(Label_Fixup {Insts.size(), id, token});
             return Nan_Box();
+        }
 
         case Token_Type::INSTRUCTION:
         case Token_Type::DIRECTIVE:
@@ -228,15 +245,16 @@ const Token &Parser::next(const Token_Type acc_types[], size_t acc_types_size, b
                 checks if the label already exists, so that 'token_as_Nan_Box' catches the redefinitions as this function should only
                 get the next token and check if the type is an accepted one by the current instruction/operation.
                 */
-            if (acc_types[i] == Token_Type::KEYWORD && Alias.contains(tokens[pos].value) && !ignore_keyword_type_check) {
+            uint32_t id;
+            if (acc_types[i] == Token_Type::KEYWORD && !ignore_keyword_type_check && Symbols.find(tokens[pos].value, id) && Symbols[id].kind == SYMBOL_ALIAS) {
                 for (size_t j = 0; j < acc_types_size && acc_types[j] != Token_Type::UNKNOWN; j++) {
-                    if (acc_types[j] == Alias[tokens[pos].value].type) {
+                    if (acc_types[j] == Symbols[id].type) {
                         return tokens[pos];
                     }
                 }
 
                 // the alias value type is not compatible with the types accepted in the current instruction/operation
-                std::cerr << "ERROR: " << tokens[pos].file_path << ":" << tokens[pos].line_number << ":" << tokens[pos].line_offset << ": KEYWORD has an invalid token type of " << Lexer::type_as_cstr(Alias[tokens[pos].value].type) << ".";
+                std::cerr << "ERROR: " << Lexer::file_path(tokens[pos].file_id) << ":" << tokens[pos].line_number << ":" << tokens[pos].line_offset << ": KEYWORD has an invalid token type of " << Lexer::type_as_cstr(Symbols[id].type) << ".";
                 std::cerr << " Expected KEYWORD with one of this types:";
                 for (size_t k = 0; k < acc_types_size && acc_types[k] != Token_Type::UNKNOWN; k++) {
                     if (acc_types[k] != Token_Type::KEYWORD)
@@ -251,7 +269,7 @@ const Token &Parser::next(const Token_Type acc_types[], size_t acc_types_size, b
     }
 
     // we do not have a valid type
-    std::cerr << "ERROR: " << tokens[pos].file_path << ":" << tokens[pos].line_number << ":" << tokens[pos].line_offset << ": Invalid token type " << Lexer::type_as_cstr(tokens[pos].type) << ".";
+    std::cerr << "ERROR: " << Lexer::file_path(tokens[pos].file_id) << ":" << tokens[pos].line_number << ":" << tokens[pos].line_offset << ": Invalid token type " << Lexer::type_as_cstr(tokens[pos].type) << ".";
     std::cerr << " Expected a token of one of this types:";
     for (size_t i = 0; i < acc_types_size && acc_types[i] != Token_Type::UNKNOWN; i++) {
         std::cerr << " " << Lexer::type_as_cstr(acc_types[i]);
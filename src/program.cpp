@@ -1,4 +1,8 @@
+#include <cstring>
+
 #include "program.h"
+#include "bytecode.h"
+#include "mapped_file.h"
 #include "vm.h"
 
 Program::Program(const Inst *list, const size_t count) {
@@ -8,15 +12,7 @@ Program::Program(const Inst *list, const size_t count) {
 }
 
 void Program::write_to_file(const char *path, const Inst *program, const size_t program_size) {
-    std::ofstream file;
-    file.open(path, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "ERROR: An error occured when trying to write a program to '" << path << "'" << std::endl;
-        exit(1);
-    }
-
-    file.write((const char *)program, static_cast<std::streamsize>(sizeof(Inst) * program_size));
-    file.close();
+    Program(program, program_size).write_to_file(path);
 }
 
 void Program::write_to_file(const char *path) {
@@ -26,27 +22,112 @@ void Program::write_to_file(const char *path) {
         exit(1);
     }
 
-    file << *this;
+    const std::vector<uint8_t> bytes = encode_program(*this);
+    file.write((const char *)bytes.data(), static_cast<std::streamsize>(bytes.size()));
     file.close();
 }
 
 void Program::read_from_file(const char *path) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) {
+    const std::shared_ptr<const Mapped_File> file = Mapped_File::open(path);
+    if (file == nullptr) {
         std::cerr << "ERROR: An error occured when trying to read a program from '" << path << "'" << std::endl;
         exit(1);
     }
 
-    file >> *this;
-    file.close();
+    std::string error;
+    if (!read_from_memory(file->bytes().data(), file->bytes().size(), error)) {
+        std::cerr << "ERROR: Could not load the program from '" << path << "': " << error << "." << std::endl;
+        exit(1);
+    }
+}
+
+bool Program::read_from_memory(const uint8_t *data, const size_t size, std::string &error) {
+    return decode_program(data, size, *this, error);
+}
+
+void Program::decode(const bool fuse) {
+    code = Code(insts, Vm::native_funcs_count);
+
+    // must run before the fusion (the verifier only knows the original instructions)
+    verification = Verifier(code).verify();
+
+    if (fuse)
+        code.fuse();
+}
+
+// 'insts' is the first member of 'Image', so the program is decoded before any of them is initialized
+static Program &decoded(Program &program, const bool fuse) {
+    if (program.code.empty())
+        program.decode(fuse);
+
+    return program;
+}
+
+// FNV-1a of the instructions (type and operand, not the padding) and the data (with its zero bytes)
+static uint64_t fingerprint_of(const std::vector<Inst> &insts, const std::span<const uint8_t> data, const uint64_t bss_size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const auto add = [&hash](const uint64_t value) {
+        for (size_t i = 0; i < sizeof(value); i++) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 0x100000001b3ULL;
+        }
+    };
+
+    add(insts.size());
+    for (const Inst &inst: insts) {
+        add(static_cast<uint64_t>(inst.type));
+        add(inst.operand.bits());
+    }
+
+    add(data.size());
+    for (const uint8_t byte: data) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    }
+
+    add(bss_size);
+    return hash;
+}
+
+Image::Image(Program &&program, const bool fuse) : Image(std::move(program), nullptr, std::span<const uint8_t>(), fuse) {}
+
+Image::Image(Program &&program, std::shared_ptr<const Mapped_File> mapped, const std::span<const uint8_t> mapped_data, const bool fuse)
+    : insts(std::move(decoded(program, fuse).insts)),
+      file(std::move(mapped)),
+      owned_data(std::move(program.memory)),
+      data(file != nullptr ? mapped_data : std::span<const uint8_t>(owned_data)),
+      bss_size(program.bss_size),
+      code(std::move(program.code)),
+      verification(std::move(program.verification)),
+      fingerprint(fingerprint_of(insts, data, bss_size)) {}
+
+std::shared_ptr<const Image> Image::load(const char *path, std::string &error, const bool fuse) {
+    std::shared_ptr<const Mapped_File> file = Mapped_File::open(path);
+    if (file == nullptr) {
+        error = std::string("An error occured when trying to read a program from '").append(path).append("'");
+        return nullptr;
+    }
+
+    // the instructions are decoded straight from the mapping and the data is used in place
+    Program program;
+    std::span<const uint8_t> data;
+    if (!decode_program(file->bytes().data(), file->bytes().size(), program, data, error)) {
+        error = std::string("Could not load the program from '").append(path).append("': ").append(error);
+        return nullptr;
+    }
+
+    return std::make_shared<const Image>(std::move(program), std::move(file), data, fuse);
 }
 
 void Program::print_program(bool with_labels) {
     size_t label_suffix = 0;
     std::unordered_map<void*, std::string> jmp_addr_label_names;
 
-    // get places for labels if requested
+    // get places for labels if requested (with their names from the '.vm' file when it has them)
     if (with_labels) {
+        for (const auto &[name, addr]: symbols)
+            jmp_addr_label_names.emplace((void*)addr, name);
+
         for (Inst& inst: insts) {
             if (inst_operand_might_be_label(inst.type) && jmp_addr_label_names.contains(inst.operand.as_ptr()) == false) {
                 jmp_addr_label_names.emplace(inst.operand.as_ptr(), "label_" + std::to_string(label_suffix));
@@ -0,0 +1,57 @@
+#include <fstream>
+
+#include "snapshot.h"
+
+#define SNAPSHOT_HEADER_WORDS 6
+
+std::shared_ptr<const Snapshot> Snapshot::load(const char *path, std::string &error) {
+    std::shared_ptr<Snapshot> snapshot(new Snapshot());
+    snapshot->file = Mapped_File::open(path);
+    if (snapshot->file == nullptr) {
+        error = std::string("An error occured when trying to read a snapshot from '").append(path).append("'");
+        return nullptr;
+    }
+
+    const uint64_t *const file = reinterpret_cast<const uint64_t*>(snapshot->file->bytes().data());
+    const size_t size = snapshot->file->bytes().size();
+
+    // the sections must be inside of the file
+    const size_t words = size / 8;
+    if (words < SNAPSHOT_HEADER_WORDS || file[0] != SNAPSHOT_MAGIC) {
+        error = std::string("'").append(path).append("' is not a snapshot");
+        return nullptr;
+    }
+
+    const uint64_t stack_size = file[3], memory_size = file[4], heap_size = file[5];
+    const uint64_t memory_words = memory_size / 8 + (memory_size % 8 != 0);
+    if (stack_size > words || memory_words > words || heap_size > words || SNAPSHOT_HEADER_WORDS + stack_size + memory_words + heap_size != words) {
+        error = std::string("The snapshot '").append(path).append("' is corrupted");
+        return nullptr;
+    }
+
+    const uint64_t *const stack = file + SNAPSHOT_HEADER_WORDS;
+    const uint64_t *const memory = stack + stack_size;
+    snapshot->fingerprint = file[1];
+    snapshot->ip = file[2];
+    snapshot->stack = std::span<const Nan_Box>(reinterpret_cast<const Nan_Box*>(stack), stack_size);
+    snapshot->memory = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(memory), memory_size);
+    snapshot->heap = std::span<const uint64_t>(memory + memory_words, heap_size);
+    return snapshot;
+}
+
+bool Snapshot::write(const char *path, const uint64_t fingerprint, const uint64_t ip, const std::span<const Nan_Box> stack, const std::span<const uint8_t> memory, const std::span<const uint64_t> heap) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    const uint64_t header[SNAPSHOT_HEADER_WORDS] = {SNAPSHOT_MAGIC, fingerprint, ip, stack.size(), memory.size(), heap.size()};
+    const char padding[8] = {};
+
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(stack.data()), static_cast<std::streamsize>(stack.size_bytes()));
+    file.write(reinterpret_cast<const char*>(memory.data()), static_cast<std::streamsize>(memory.size()));
+    file.write(padding, static_cast<std::streamsize>((8 - memory.size() % 8) % 8));
+    file.write(reinterpret_cast<const char*>(heap.data()), static_cast<std::streamsize>(heap.size_bytes()));
+    file.close();
+    return !file.fail();
+}
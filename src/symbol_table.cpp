@@ -0,0 +1,18 @@
+#include "symbol_table.h"
+
+uint32_t Symbol_Table::intern(const std::string_view name) {
+    const auto [it, added] = ids.try_emplace(name, static_cast<uint32_t>(symbols.size()));
+    if (added)
+        symbols.push_back(Symbol {name, SYMBOL_UNDEFINED, Token_Type::UNKNOWN, Nan_Box(), Token {}});
+
+    return it->second;
+}
+
+bool Symbol_Table::find(const std::string_view name, uint32_t &id) const {
+    const auto it = ids.find(name);
+    if (it == ids.end())
+        return false;
+
+    id = it->second;
+    return true;
+}
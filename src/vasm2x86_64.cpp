@@ -160,6 +160,32 @@ int main(int argc, char const *argv[]) {
             break;
         case Inst_Type::INST_WRITE:
             break;
+        case Inst_Type::INST_READF:
+            break;
+        case Inst_Type::INST_WRITEF:
+            break;
+        case Inst_Type::INST_COPY:
+            break;
+        case Inst_Type::INST_FILL:
+            break;
+        case Inst_Type::INST_COMPARE:
+            break;
+        case Inst_Type::INST_VADD:
+        case Inst_Type::INST_VSUB:
+        case Inst_Type::INST_VMUL:
+        case Inst_Type::INST_VDIV:
+        case Inst_Type::INST_VFMA:
+        case Inst_Type::INST_VSCALE:
+        case Inst_Type::INST_VDOT:
+        case Inst_Type::INST_VSUM:
+        case Inst_Type::INST_VMIN:
+        case Inst_Type::INST_VMAX:
+            break;
+        case Inst_Type::INST_SPAWN:
+        case Inst_Type::INST_YIELD:
+        case Inst_Type::INST_JOIN:
+        case Inst_Type::INST_SLEEP:
+            break;
         case Inst_Type::INST_DUMP_STACK:
             break;
         case Inst_Type::INST_DUMP_MEMORY:
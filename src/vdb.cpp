@@ -15,7 +15,7 @@
 // break 0              -> set breakpoint at addr 0
 // info (break | ...)   -> get information about something
 // delete (break 0 | ...) -> delete something
-// x 0 10               -> inspect (print) the memory from addr 0 to 10
+// x 0 10               -> inspect (print) the memory (bytes) from addr 0 to 10
 
 class Vdb {
 public:
@@ -85,7 +85,7 @@ public:
                 std::cout << "    break (label | 0)     -> set breakpoint at label or addr 0" << std::endl;
                 std::cout << "    info (break | ...)    -> get information about some command" << std::endl;
                 std::cout << "    delete 0              -> delete breakpoint previously set at addr 0" << std::endl;
-                std::cout << "    x 0 10                -> inspect (print) the memory from addr 0 to 10" << std::endl;
+                std::cout << "    x 0 10                -> inspect (print) the memory (bytes) from addr 0 to 10" << std::endl;
                 break;
 
             case Vdb_Command_Type::INFO:
@@ -146,31 +146,14 @@ public:
                     break;
                 }
 
-                if (base_addr >= p.memory.size() || top_addr >= p.memory.size()) {
-                    std::cout << "Addrs are out of range. Current memory size: " << p.memory.size() << std::endl;
+                // the memory of the vm (the program only has the initial values)
+                const Vm_Memory &memory = vm.get_memory();
+                if (base_addr >= memory.size() || top_addr >= memory.size()) {
+                    std::cout << "Addrs are out of range. Current memory size: " << memory.size() << std::endl;
                     break;
                 }
 
-                for (uint64_t i = base_addr; i <= top_addr; i++) {
-                    switch (p.memory[i].get_type()) {
-                    case Nan_Type::DOUBLE:
-                        std::cout << "    # Double: " << p.memory[i].as_double() << std::endl;
-                        break;
-
-                    case Nan_Type::INT:
-                        std::cout << "    # Int: " << p.memory[i].as_int() << std::endl;
-                        break;
-
-                    case Nan_Type::PTR:
-                        std::cout << "    # Ptr: " << p.memory[i].as_ptr() << std::endl;
-                        break;
-
-                    case Nan_Type::EXCEPTION:
-                    default:
-                        std::cerr << "ERROR: Unknown variable data type in the memory." << std::endl;
-                        exit(1);
-                    }
-                }
+                Vm::dump_bytes(std::cout, memory.bytes(), base_addr, top_addr + 1);
             }
             break;
 
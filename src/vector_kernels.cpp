@@ -0,0 +1,285 @@
+#include <cstring>
+#include <bit>
+#include <type_traits>
+
+#include "vector_kernels.h"
+
+/*
+ The kernels are written once with the vector extensions of gcc/clang and instantiated for each instruction set
+ (with the 'target' attribute), 'W' is the size of the vectors in bytes (0 for the scalar kernels).
+ Everything is inlined into the functions with the 'target' attribute, so the vectors are never passed between functions
+ compiled for different instruction sets (that is what the 'psabi' warnings are about).
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define ALWAYS_INLINE inline __attribute__((always_inline))
+    #define INLINE_LAMBDA __attribute__((always_inline))
+    #pragma GCC diagnostic ignored "-Wpsabi"
+#else
+    #define ALWAYS_INLINE inline
+    #define INLINE_LAMBDA
+#endif
+
+#ifdef HAS_X86_VECTOR_KERNELS
+template <typename T, size_t W>
+struct Simd { typedef T type __attribute__((vector_size(W))); };
+#else
+template <typename T, size_t W>
+struct Simd { typedef T type; }; // only used with 'W' bigger than 0
+#endif
+
+#define ELEMENT_SIZE VECTOR_ELEMENT_SIZE
+
+// little-endian elements (compiles to a plain load/store on little-endian cpus)
+template <typename T>
+ALWAYS_INLINE T load(const uint8_t *const src) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < ELEMENT_SIZE; i++)
+        bits |= static_cast<uint64_t>(src[i]) << (8 * i);
+
+    return std::bit_cast<T>(bits);
+}
+
+template <typename T>
+ALWAYS_INLINE void store(uint8_t *const dst, const T value) {
+    const uint64_t bits = std::bit_cast<uint64_t>(value);
+    for (size_t i = 0; i < ELEMENT_SIZE; i++)
+        dst[i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+// the vectors are only used on x86, that is little-endian like the vm memory
+template <typename V>
+ALWAYS_INLINE V load_vector(const uint8_t *const src) {
+    V value;
+    std::memcpy(&value, src, sizeof(V));
+    return value;
+}
+
+template <typename V>
+ALWAYS_INLINE void store_vector(uint8_t *const dst, const V value) {
+    std::memcpy(dst, &value, sizeof(V));
+}
+
+// dst[i] = op(a[i], b[i], dst[i])
+template <typename T, size_t W, typename Op>
+ALWAYS_INLINE void element_wise(uint8_t *const dst, const uint8_t *const a, const uint8_t *const b, const size_t n, Op op) {
+    size_t i = 0;
+
+    if constexpr (W > 0) {
+        typedef typename Simd<T, W>::type V;
+        constexpr size_t lanes = W / sizeof(T);
+
+        for (; i + lanes <= n; i += lanes) {
+            const size_t offset = i * ELEMENT_SIZE;
+            store_vector<V>(dst + offset, op(load_vector<V>(a + offset), load_vector<V>(b + offset), load_vector<V>(dst + offset)));
+        }
+    }
+
+    for (; i < n; i++) {
+        const size_t offset = i * ELEMENT_SIZE;
+        store<T>(dst + offset, op(load<T>(a + offset), load<T>(b + offset), load<T>(dst + offset)));
+    }
+}
+
+// op(...op(op(init, f(0)), f(1))..., f(n-1)), with one partial result per vector lane
+template <typename T, size_t W, typename Op, typename F, typename VF>
+ALWAYS_INLINE T reduce(const size_t n, const T init, Op op, F element, VF vector_element) {
+    T result = init;
+    size_t i = 0;
+
+    if constexpr (W > 0) {
+        typedef typename Simd<T, W>::type V;
+        constexpr size_t lanes = W / sizeof(T);
+
+        if (n >= lanes) {
+            V acc = vector_element.template operator()<V>(0);
+            for (i = lanes; i + lanes <= n; i += lanes)
+                acc = op(acc, vector_element.template operator()<V>(i));
+
+            for (size_t lane = 0; lane < lanes; lane++)
+                result = op(result, static_cast<T>(acc[lane]));
+        }
+    }
+
+    for (; i < n; i++)
+        result = op(result, element(i));
+
+    return result;
+}
+
+// the operations (the same code works with scalars and with vectors)
+#define OP_ADD [](auto a, auto b, auto) INLINE_LAMBDA { return a + b; }
+#define OP_SUB [](auto a, auto b, auto) INLINE_LAMBDA { return a - b; }
+#define OP_MUL [](auto a, auto b, auto) INLINE_LAMBDA { return a * b; }
+#define OP_DIV [](auto a, auto b, auto) INLINE_LAMBDA { return a / b; }
+#define OP_FMA [](auto a, auto b, auto d) INLINE_LAMBDA { return d + a * b; }
+#define RED_ADD [](auto acc, auto x) INLINE_LAMBDA { return acc + x; }
+#define RED_MIN [](auto acc, auto x) INLINE_LAMBDA { return x < acc ? x : acc; }
+#define RED_MAX [](auto acc, auto x) INLINE_LAMBDA { return x > acc ? x : acc; }
+
+template <typename T, size_t W>
+ALWAYS_INLINE void scale_kernel(uint8_t *const dst, const uint8_t *const a, const T s, const size_t n) {
+    size_t i = 0;
+
+    if constexpr (W > 0) {
+        typedef typename Simd<T, W>::type V;
+        constexpr size_t lanes = W / sizeof(T);
+
+        for (; i + lanes <= n; i += lanes)
+            store_vector<V>(dst + i * ELEMENT_SIZE, load_vector<V>(a + i * ELEMENT_SIZE) * s);
+    }
+
+    for (; i < n; i++)
+        store<T>(dst + i * ELEMENT_SIZE, load<T>(a + i * ELEMENT_SIZE) * s);
+}
+
+template <typename T, size_t W>
+ALWAYS_INLINE T dot_kernel(const uint8_t *const a, const uint8_t *const b, const size_t n) {
+    return reduce<T, W>(n, T(0), RED_ADD,
+        [a, b](const size_t i) INLINE_LAMBDA { return load<T>(a + i * ELEMENT_SIZE) * load<T>(b + i * ELEMENT_SIZE); },
+        [a, b]<typename V>(const size_t i) INLINE_LAMBDA { return load_vector<V>(a + i * ELEMENT_SIZE) * load_vector<V>(b + i * ELEMENT_SIZE); });
+}
+
+template <typename T, size_t W, typename Op>
+ALWAYS_INLINE T reduce_kernel(const uint8_t *const a, const size_t n, const T init, Op op) {
+    return reduce<T, W>(n, init, op,
+        [a](const size_t i) INLINE_LAMBDA { return load<T>(a + i * ELEMENT_SIZE); },
+        [a]<typename V>(const size_t i) INLINE_LAMBDA { return load_vector<V>(a + i * ELEMENT_SIZE); });
+}
+
+// the int division is never vectorized (there are no vector instructions for it) and checks for zero
+template <typename T, size_t W>
+ALWAYS_INLINE bool div_kernel(uint8_t *const dst, const uint8_t *const a, const uint8_t *const b, const size_t n) {
+    if constexpr (std::is_floating_point_v<T>) {
+        element_wise<T, W>(dst, a, b, n, OP_DIV);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            const T divisor = load<T>(b + i * ELEMENT_SIZE);
+            if (divisor == 0)
+                return false;
+
+            // the only overflow of a division
+            const T dividend = load<T>(a + i * ELEMENT_SIZE);
+            store<T>(dst + i * ELEMENT_SIZE, divisor == -1 ? static_cast<T>(0 - static_cast<uint64_t>(dividend)) : dividend / divisor);
+        }
+    }
+
+    return true;
+}
+
+// the int kernels work with unsigned ints (wrap around on overflow), the result has the same bits
+template <typename T>
+struct Storage { typedef T type; };
+template <>
+struct Storage<int64_t> { typedef uint64_t type; };
+
+/*
+ Defines the functions of the kernels in the namespace 'isa', compiled with the attributes 'attrs'.
+ 'W' is the size of the vectors (0 for scalar code).
+ */
+#define DEFINE_KERNELS(isa, W, attrs)                                                                                                 \
+    namespace isa {                                                                                                                  \
+        template <typename T> attrs void add(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n) {                             \
+            element_wise<typename Storage<T>::type, W>(d, a, b, n, OP_ADD);                                                          \
+        }                                                                                                                            \
+        template <typename T> attrs void sub(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n) {                             \
+            element_wise<typename Storage<T>::type, W>(d, a, b, n, OP_SUB);                                                          \
+        }                                                                                                                            \
+        template <typename T> attrs void mul(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n) {                             \
+            element_wise<typename Storage<T>::type, W>(d, a, b, n, OP_MUL);                                                          \
+        }                                                                                                                            \
+        template <typename T> attrs bool div(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n) {                             \
+            return div_kernel<T, W>(d, a, b, n);                                                                                     \
+        }                                                                                                                            \
+        template <typename T> attrs void fma(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n) {                             \
+            element_wise<typename Storage<T>::type, W>(d, a, b, n, OP_FMA);                                                          \
+        }                                                                                                                            \
+        template <typename T> attrs void scale(uint8_t *d, const uint8_t *a, T s, size_t n) {                                        \
+            typedef typename Storage<T>::type S;                                                                                     \
+            scale_kernel<S, W>(d, a, static_cast<S>(s), n);                                                                          \
+        }                                                                                                                            \
+        template <typename T> attrs T dot(const uint8_t *a, const uint8_t *b, size_t n) {                                            \
+            return static_cast<T>(dot_kernel<typename Storage<T>::type, W>(a, b, n));                                                \
+        }                                                                                                                            \
+        template <typename T> attrs T sum(const uint8_t *a, size_t n) {                                                              \
+            typedef typename Storage<T>::type S;                                                                                     \
+            return static_cast<T>(reduce_kernel<S, W>(a, n, S(0), RED_ADD));                                                         \
+        }                                                                                                                            \
+        template <typename T> attrs T min(const uint8_t *a, size_t n) {                                                              \
+            return reduce_kernel<T, W>(a, n, load<T>(a), RED_MIN);                                                                   \
+        }                                                                                                                            \
+        template <typename T> attrs T max(const uint8_t *a, size_t n) {                                                              \
+            return reduce_kernel<T, W>(a, n, load<T>(a), RED_MAX);                                                                   \
+        }                                                                                                                            \
+    }
+
+#define KERNELS(isa, name) {name, {isa::add<double>, isa::sub<double>, isa::mul<double>, isa::div<double>, isa::fma<double>,                     \
+                                   isa::scale<double>, isa::dot<double>, isa::sum<double>, isa::min<double>, isa::max<double>},                 \
+                                  {isa::add<int64_t>, isa::sub<int64_t>, isa::mul<int64_t>, isa::div<int64_t>, isa::fma<int64_t>,               \
+                                   isa::scale<int64_t>, isa::dot<int64_t>, isa::sum<int64_t>, isa::min<int64_t>, isa::max<int64_t>}}
+
+DEFINE_KERNELS(scalar, 0, )
+
+#ifdef HAS_X86_VECTOR_KERNELS
+DEFINE_KERNELS(sse2, 16, __attribute__((target("sse2"))))
+DEFINE_KERNELS(avx2, 32, __attribute__((target("avx2,fma"))))
+DEFINE_KERNELS(avx512, 64, __attribute__((target("avx512f,avx512dq"))))
+
+static const Vector_Kernels all_kernels[VECTOR_ISA_COUNT] = {
+    KERNELS(scalar, "scalar"),
+    KERNELS(sse2, "sse2"),
+    KERNELS(avx2, "avx2"),
+    KERNELS(avx512, "avx512")
+};
+#else
+static const Vector_Kernels all_kernels[VECTOR_ISA_COUNT] = {
+    KERNELS(scalar, "scalar"),
+    KERNELS(scalar, "scalar"),
+    KERNELS(scalar, "scalar"),
+    KERNELS(scalar, "scalar")
+};
+#endif
+
+bool vector_isa_supported(const Vector_Isa isa) {
+    switch (isa) {
+    case VECTOR_ISA_SCALAR:
+        return true;
+
+#ifdef HAS_X86_VECTOR_KERNELS
+    case VECTOR_ISA_SSE2:
+        return __builtin_cpu_supports("sse2");
+
+    case VECTOR_ISA_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+    case VECTOR_ISA_AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+#else
+    case VECTOR_ISA_SSE2:
+    case VECTOR_ISA_AVX2:
+    case VECTOR_ISA_AVX512:
+        return false;
+#endif
+
+    case VECTOR_ISA_COUNT:
+    default:
+        return false;
+    }
+}
+
+const Vector_Kernels &vector_kernels(const Vector_Isa isa) {
+    return all_kernels[vector_isa_supported(isa) ? isa : VECTOR_ISA_SCALAR];
+}
+
+const Vector_Kernels &vector_kernels() {
+    static const Vector_Kernels &best = []() -> const Vector_Kernels & {
+        for (int isa = VECTOR_ISA_COUNT - 1; isa > VECTOR_ISA_SCALAR; isa--) {
+            if (vector_isa_supported(static_cast<Vector_Isa>(isa)))
+                return all_kernels[isa];
+        }
+
+        return all_kernels[VECTOR_ISA_SCALAR];
+    }();
+
+    return best;
+}
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <limits>
+
+#include "verifier.h"
+
+// used when the position of the return addr is not known (or when there is none, like in the entry point)
+#define NO_POS std::numeric_limits<int64_t>::min()
+
+// number of values an instruction needs on the stack and how much it changes the stack depth
+static void stack_effect(const uint8_t op, const int64_t operand, int64_t &need, int64_t &delta) {
+    need = 0;
+    delta = 0;
+
+    switch (op) {
+    case Inst_Type::INST_PUSH:
+        delta = 1;
+        break;
+
+    case Inst_Type::INST_POP:
+    case Inst_Type::INST_JMP_IF:
+        need = 1;
+        delta = -1;
+        break;
+
+    case Inst_Type::INST_DUP:
+        need = operand; // the decoded operand is the offset from the top ('index + 1')
+        delta = 1;
+        break;
+
+    case Inst_Type::INST_SWAP:
+    case Inst_Type::INST_PRINT:
+    case Inst_Type::INST_TD:
+    case Inst_Type::INST_TI:
+    case Inst_Type::INST_TP:
+        need = operand;
+        break;
+
+    case Inst_Type::INST_ADD:
+    case Inst_Type::INST_SUB:
+    case Inst_Type::INST_MUL:
+    case Inst_Type::INST_DIV:
+    case Inst_Type::INST_MOD:
+    case Inst_Type::INST_AND:
+    case Inst_Type::INST_OR:
+    case Inst_Type::INST_XOR:
+    case Inst_Type::INST_SHL:
+    case Inst_Type::INST_SHR:
+    case Inst_Type::INST_SAR:
+    case Inst_Type::INST_EQU:
+        need = 2;
+        delta = -1;
+        break;
+
+    case Inst_Type::INST_NOT:
+    case Inst_Type::INST_RET:
+        need = 1;
+        break;
+
+    case Inst_Type::INST_READ:
+    case Inst_Type::INST_READF:
+        need = 1;
+        break;
+
+    case Inst_Type::INST_WRITE:
+    case Inst_Type::INST_WRITEF:
+        need = 2;
+        delta = -2;
+        break;
+
+    case Inst_Type::INST_COPY:
+    case Inst_Type::INST_FILL:
+        need = 3;
+        delta = -3;
+        break;
+
+    case Inst_Type::INST_COMPARE:
+        need = 3;
+        delta = -2;
+        break;
+
+    case Inst_Type::INST_VADD:
+    case Inst_Type::INST_VSUB:
+    case Inst_Type::INST_VMUL:
+    case Inst_Type::INST_VDIV:
+    case Inst_Type::INST_VFMA:
+    case Inst_Type::INST_VSCALE:
+        need = 4;
+        delta = -4;
+        break;
+
+    case Inst_Type::INST_VDOT:
+        need = 3;
+        delta = -2;
+        break;
+
+    case Inst_Type::INST_VSUM:
+    case Inst_Type::INST_VMIN:
+    case Inst_Type::INST_VMAX:
+        need = 2;
+        delta = -1;
+        break;
+
+    case Inst_Type::INST_SPAWN: // the argument is replaced by the id
+    case Inst_Type::INST_JOIN:  // the id is replaced by the result
+        need = 1;
+        break;
+
+    case Inst_Type::INST_SLEEP:
+        need = 1;
+        delta = -1;
+        break;
+
+    case Inst_Type::INST_NATIVE:
+        // the native functions do not check the stack themselves (see 'Vm::native_funcs_names' for the order)
+        switch (operand) {
+        case 0: need = 1; delta = 0;  break; // malloc
+        case 1: need = 1; delta = -1; break; // free
+        case 2: need = 3; delta = 0;  break; // fwrite
+        case 3: need = 3; delta = 0;  break; // fread
+        case 4: need = 3; delta = -2; break; // fopen
+        case 5: need = 1; delta = 0;  break; // fclose
+        case 6: need = 4; delta = -3; break; // aread
+        case 7: need = 4; delta = -3; break; // awrite
+        case 8: need = 1; delta = 0;  break; // asubmit
+        case 9: need = 1; delta = 0;  break; // apoll
+        case 10: need = 1; delta = 0; break; // await
+        case 11: need = 1; delta = 0; break; // snapshot
+        default: break;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+bool Verifier::fail(const uint64_t addr, const std::string &reason) {
+    if (error.empty())
+        error = "addr " + std::to_string(addr) + ": " + reason;
+
+    return false;
+}
+
+Verification Verifier::verify() {
+    summaries.clear();
+    function_order.clear();
+    spawn_entries.clear();
+    spawned.clear();
+    error.clear();
+
+    Verification result {false, "", 0, {}};
+    if (!analyze(0, false)) {
+        result.error = error;
+        return result;
+    }
+
+    const Summary &main = summaries.at(0);
+    result.verified = true;
+    result.max_stack_height = static_cast<size_t>(main.max);
+
+    // a coroutine starts with its argument and the return addr on the stack (every coroutine runs on the whole vm stack)
+    for (const uint64_t entry: spawn_entries) {
+        const Summary &coroutine = summaries.at(entry);
+        if (coroutine.need > COROUTINE_ENTRY_DEPTH) {
+            result.verified = false;
+            result.error = "addr " + std::to_string(entry) + ": coroutine might underflow the stack";
+            return result;
+        }
+
+        result.max_stack_height = std::max(result.max_stack_height, static_cast<size_t>(COROUTINE_ENTRY_DEPTH + coroutine.max));
+    }
+
+    result.functions.push_back(Function_Info {0, static_cast<size_t>(main.max)});
+    for (const uint64_t entry: function_order) {
+        result.functions.push_back(Function_Info {entry, static_cast<size_t>(summaries.at(entry).max)});
+    }
+
+    return result;
+}
+
+bool Verifier::analyze(const uint64_t entry, const bool is_function) {
+    // abstract state before an instruction: depth relative to the entry and position of the return addr
+    typedef struct {
+        int64_t depth;
+        int64_t ret_pos;
+    } State;
+
+    Summary summary {true, false, 0, 0, 0, 0};
+    summaries[entry] = summary;
+
+    std::unordered_map<uint64_t, State> states;
+    std::vector<uint64_t> worklist;
+
+    // returns false if 'addr' was already reached with a different state
+    auto reach = [&](const uint64_t addr, const State state) {
+        // the exit appended to the end of the program and the trap for invalid jumps end the execution
+        if (addr >= code.size())
+            return true;
+
+        const auto it = states.find(addr);
+        if (it == states.end()) {
+            states.emplace(addr, state);
+            worklist.push_back(addr);
+            return true;
+        }
+
+        if (it->second.depth != state.depth)
+            return fail(addr, "reached with different stack depths (" + std::to_string(it->second.depth) + " and " + std::to_string(state.depth) + ")");
+
+        if (it->second.ret_pos != state.ret_pos)
+            return fail(addr, "reached with the return addr in different stack positions");
+
+        return true;
+    };
+
+    // the return addr pushed by 'call' is just below the function entry
+    if (!reach(entry, State {0, is_function ? -1 : NO_POS}))
+        return false;
+
+    while (!worklist.empty()) {
+        const uint64_t addr = worklist.back();
+        worklist.pop_back();
+
+        const uint8_t op = code.ops[addr];
+        const int64_t operand = code.operands[addr];
+        const int64_t depth = states.at(addr).depth;
+        int64_t ret_pos = states.at(addr).ret_pos;
+
+        if (op == Inst_Type::INST_CALL) {
+            const uint64_t target = static_cast<uint64_t>(operand);
+            if (target >= code.size())
+                continue; // invalid target, raises an exception
+
+            if (!summaries.contains(target)) {
+                function_order.push_back(target);
+                if (!analyze(target, true))
+                    return false;
+            }
+
+            const Summary &callee = summaries.at(target);
+            if (callee.in_progress)
+                return fail(addr, "recursive call to addr " + std::to_string(target));
+
+            // the callee entry is one above the current depth (the return addr)
+            const int64_t base = depth + 1;
+            if (!is_function && callee.need > base)
+                return fail(addr, "might underflow the stack (in the called function)");
+
+            summary.need = std::max(summary.need, callee.need - base);
+            summary.max = std::max(summary.max, base + callee.max);
+            summary.low_write = std::min(summary.low_write, base + callee.low_write);
+            if (ret_pos != NO_POS && ret_pos >= base + callee.low_write)
+                ret_pos = NO_POS;
+
+            if (callee.returns && !reach(addr + 1, State {base + callee.ret_depth, ret_pos}))
+                return false;
+
+            continue;
+        }
+
+        // the coroutine has its own stack, only its summary is needed (it can also spawn itself)
+        // a target that was already analyzed (as a 'call' target) must still be checked as a coroutine entry
+        if (op == Inst_Type::INST_SPAWN && static_cast<uint64_t>(operand) < code.size()) {
+            const uint64_t target = static_cast<uint64_t>(operand);
+            if (spawned.insert(target).second)
+                spawn_entries.push_back(target);
+
+            if (!summaries.contains(target)) {
+                function_order.push_back(target);
+                if (!analyze(target, true))
+                    return false;
+            }
+        }
+
+        int64_t need, delta;
+        stack_effect(op, operand, need, delta);
+        summary.need = std::max(summary.need, need - depth);
+        summary.max = std::max(summary.max, depth + delta);
+
+        if (!is_function && need > depth)
+            return fail(addr, "might underflow the stack");
+
+        // track the position of the return addr (and the lowest position changed)
+        switch (op) {
+        case Inst_Type::INST_PUSH:
+        case Inst_Type::INST_DUP:
+            summary.low_write = std::min(summary.low_write, depth);
+            break;
+
+        case Inst_Type::INST_PRINT:
+            break;
+
+        case Inst_Type::INST_SWAP:
+            summary.low_write = std::min(summary.low_write, depth - need);
+            if (ret_pos == depth - 1)
+                ret_pos = depth - need;
+            else if (ret_pos == depth - need)
+                ret_pos = depth - 1;
+            break;
+
+        case Inst_Type::INST_TD:
+        case Inst_Type::INST_TI:
+        case Inst_Type::INST_TP:
+            summary.low_write = std::min(summary.low_write, depth - need);
+            if (ret_pos == depth - need)
+                ret_pos = NO_POS;
+            break;
+
+        default:
+            summary.low_write = std::min(summary.low_write, depth - need);
+            if (ret_pos != NO_POS && ret_pos >= depth - need && op != Inst_Type::INST_RET)
+                ret_pos = NO_POS;
+            break;
+        }
+
+        switch (op) {
+        case Inst_Type::INST_EXIT:
+        case Inst_Type::INST_HALT:
+        case Internal_Op::OP_TRAP:
+            // ends the execution
+            break;
+
+        case Inst_Type::INST_JMP:
+            if (!reach(static_cast<uint64_t>(operand), State {depth, ret_pos}))
+                return false;
+            break;
+
+        case Inst_Type::INST_JMP_IF:
+            if (!reach(static_cast<uint64_t>(operand), State {depth + delta, ret_pos}) || !reach(addr + 1, State {depth + delta, ret_pos}))
+                return false;
+            break;
+
+        case Inst_Type::INST_RET:
+            if (!is_function)
+                return fail(addr, "'ret' outside of a function");
+
+            if (ret_pos != depth - 1)
+                return fail(addr, "'ret' without the return addr on top of the stack");
+
+            if (summary.returns && summary.ret_depth != depth - 1)
+                return fail(addr, "function returns with different stack depths");
+
+            summary.returns = true;
+            summary.ret_depth = depth - 1;
+            break;
+
+        default:
+            if (!reach(addr + 1, State {depth + delta, ret_pos}))
+                return false;
+            break;
+        }
+    }
+
+    summary.in_progress = false;
+    summaries[entry] = summary;
+    return true;
+}
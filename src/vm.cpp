@@ -1,43 +1,405 @@
 #include <iostream>
 #include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <algorithm>
+#include <iomanip>
+#include <cctype>
+#include <bit>
+#include <type_traits>
+#include <thread>
+#include <condition_variable>
 
 #include "vm.h"
 
-void Vm::execute_program(const bool debug_mode) {
+// the capacity is rounded up to fill the last page of the stack, so the guard page starts right after the last value
+template <typename Box>
+Basic_Vm<Box>::Basic_Vm(std::shared_ptr<const Image> image, const size_t stack_cap)
+    : image(std::move(image)),
+      heap(memory),
+      stack_region(stack_cap * sizeof(Box)),
+      stack(static_cast<Box*>(stack_region.data())),
+      stack_cap(stack_region.size() / sizeof(Box)),
+      fuel(UNLIMITED_FUEL),
+      fuel_limit(UNLIMITED_FUEL),
+      timeout(0),
+      interrupted(false),
+      out(1),
+      err(2),
+      has_input(false) {}
+
+template <typename Box>
+Basic_Vm<Box>::Basic_Vm(const Program &program, const size_t stack_cap)
+    : Basic_Vm(std::make_shared<const Image>(Program(program)), stack_cap) {}
+
+template <typename Box>
+void Basic_Vm<Box>::execute_program(const bool debug_mode, const Dispatch_Mode mode) {
     // check for empty program
-    if (program.insts.size() == 0) {
+    if (image->insts.size() == 0) {
         std::cout << "WARNING: Ignoring empty program!" << std::endl;
         return;
     }
 
-    // reset the vm
+    // the debugger executes the program one instruction at a time (see 'next')
+    if (debug_mode) {
+        if (!reset())
+            exception_handler(Exception_Type::EXCEPTION_OUT_OF_MEMORY);
+        return;
+    }
+
+    const Exception_Type exception = run(mode);
+    if (exception != Exception_Type::EXCEPTION_OK) {
+        exception_handler(exception);
+        exit(1);
+    }
+}
+
+template <typename Box>
+bool Basic_Vm<Box>::reset() {
     ip = 0;
     sp = 0;
-    current_program_size = program.insts.size();
+    current_program_size = image->insts.size();
+    fuel = fuel_limit;
+    interrupted.store(false, std::memory_order_relaxed);
+
+    reset_coroutines();
+    io.reset();
+
+    // the saved state was checked by 'set_snapshot'
+    if (snapshot) {
+        ip = snapshot->ip;
+        sp = snapshot->stack.size();
+        for (size_t i = 0; i < sp; i++)
+            stack[i] = Box(snapshot->stack[i]);
+
+        // 'set_snapshot' already loaded them once, but resizing the memory can still fail
+        if (!memory.assign(snapshot->memory) || !heap.load(snapshot->heap.data(), snapshot->heap.size()))
+            return false;
+    } else {
+        // each run starts with a copy of the data of the image (reusing the memory of the previous run, see 'Vm_Memory' for why
+        // it is not mapped from the file), its zero-filled blocks (only mapped) and an empty heap
+        if (!memory.assign(image->data, image->bss_size) || !heap.reset())
+            return false;
+    }
 
-    for (size_t i = 0; i < EXECUTION_LIMIT && ip < current_program_size && !debug_mode; i++) {
-        const Exception_Type exception = execute_instruction(program.insts.at(ip));
+    // 'run' checked that they fit
+    std::copy(arguments.begin(), arguments.end(), stack + sp);
+    sp += arguments.size();
+    return true;
+}
 
-        if (exception == Exception_Type::EXCEPTION_EXIT)
-            break;
+template <typename Box>
+bool Basic_Vm<Box>::set_snapshot(std::shared_ptr<const Snapshot> snapshot) {
+    if (snapshot) {
+        if (snapshot->fingerprint != image->fingerprint || snapshot->ip > image->insts.size() || snapshot->stack.size() > stack_cap)
+            return false;
 
-        if (exception != Exception_Type::EXCEPTION_OK) {
-            exception_handler(exception);
-            exit(1);
+        // the heap bookkeeping must match the saved memory
+        if (!memory.assign(snapshot->memory))
+            return false;
+
+        if (!heap.load(snapshot->heap.data(), snapshot->heap.size())) {
+            heap.reset();
+            return false;
         }
     }
+
+    this->snapshot = std::move(snapshot);
+    return true;
 }
 
-Exception_Type Vm::next() {
-    return ip < current_program_size ? execute_instruction(program.insts.at(ip)) : Exception_Type::EXCEPTION_EXIT;
+template <typename Box>
+Exception_Type Basic_Vm<Box>::run(const Dispatch_Mode mode) {
+    if ((snapshot ? snapshot->stack.size() : 0) + arguments.size() > stack_cap)
+        return Exception_Type::EXCEPTION_STACK_OVERFLOW;
+
+    if (!reset())
+        return Exception_Type::EXCEPTION_OUT_OF_MEMORY;
+
+    // interrupts the program when the timeout expires (the thread is stopped and joined when returning)
+    std::jthread watchdog;
+    if (timeout.count() > 0) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        watchdog = std::jthread([this, deadline](std::stop_token stop) {
+            std::mutex mutex;
+            std::condition_variable_any cv;
+            std::unique_lock lock(mutex);
+
+            cv.wait_until(lock, stop, deadline, []() { return false; });
+            if (!stop.stop_requested())
+                interrupt();
+        });
+    }
+
+    Exception_Type exception = Exception_Type::EXCEPTION_OK;
+    switch (mode) {
+    case Dispatch_Mode::THREADED:
+        // the code is only copied by the first run, the next runs keep the quickened instructions
+        if (code.empty()) {
+            code = image->code;
+            code.reencode<Box>();
+        }
+
+        exception = run_threaded();
+        break;
+
+    case Dispatch_Mode::PROFILE:
+        exception = run_profiled();
+        break;
+
+    case Dispatch_Mode::SWITCH:
+    default:
+        while (exception == Exception_Type::EXCEPTION_OK) {
+            if (ip >= current_program_size) {
+                exception = end_of_code();
+                continue;
+            }
+
+            exception = consume_fuel(1);
+            if (exception == Exception_Type::EXCEPTION_OK)
+                exception = execute_instruction(image->insts.at(ip));
+        }
+        break;
+    }
+
+    // the buffered output goes out before the exception (or the output of the caller)
+    sync_output();
+    return exception == Exception_Type::EXCEPTION_EXIT ? Exception_Type::EXCEPTION_OK : exception;
 }
 
-Exception_Type Vm::execute_instruction(Inst& inst) {
-    // check for stack overflow
-    if (sp >= STACK_CAP) {
-        std::cerr << "ERROR: Stack Overflow in '" << __func__ << "'" << std::endl;
-        exit(1);
+template <typename Box>
+Exception_Type Basic_Vm<Box>::run_profiled() {
+    constexpr size_t n = Inst_Type::INST_COUNT;
+    inst_counts.assign(n, 0);
+    pair_counts.assign(n * n, 0);
+    triple_counts.assign(n * n * n, 0);
+
+    // only sequences of instructions that are next to each other in the program are recorded (the ones that can be fused)
+    size_t history = 0; // number of valid entries in 'prev'
+    size_t prev[2] = {0, 0};
+    uint64_t prev_ip = 0;
+
+    for (;;) {
+        if (ip >= current_program_size) {
+            if (const Exception_Type exception = end_of_code(); exception != Exception_Type::EXCEPTION_OK)
+                return exception;
+            continue;
+        }
+
+        const Exception_Type fuel_exception = consume_fuel(1);
+        if (fuel_exception != Exception_Type::EXCEPTION_OK)
+            return fuel_exception;
+
+        const size_t type = static_cast<size_t>(image->insts[ip].type);
+        if (history > 0 && ip != prev_ip + 1)
+            history = 0;
+
+        inst_counts[type]++;
+        if (history >= 1)
+            pair_counts[prev[1] * n + type]++;
+        if (history >= 2)
+            triple_counts[(prev[0] * n + prev[1]) * n + type]++;
+
+        prev[0] = prev[1];
+        prev[1] = type;
+        prev_ip = ip;
+        history = std::min(history + 1, static_cast<size_t>(2));
+
+        const Exception_Type exception = execute_instruction(image->insts[ip]);
+        if (exception != Exception_Type::EXCEPTION_OK)
+            return exception;
     }
+}
+
+template <typename Box>
+void Basic_Vm<Box>::dump_profile(std::ostream &os, const size_t top) {
+    constexpr size_t n = Inst_Type::INST_COUNT;
+
+    // prints the 'top' most frequent entries of 'counts', 'width' is the number of instructions in each entry
+    auto dump = [&os, top](const char *title, const std::vector<uint64_t> &counts, const size_t width) {
+        std::vector<size_t> idxs;
+        for (size_t i = 0; i < counts.size(); i++) {
+            if (counts[i] > 0)
+                idxs.push_back(i);
+        }
+
+        std::sort(idxs.begin(), idxs.end(), [&counts](size_t a, size_t b) { return counts[a] > counts[b]; });
+        os << title << ":" << std::endl;
+        for (size_t i = 0; i < idxs.size() && i < top; i++) {
+            os << "    " << counts[idxs[i]] << "\t";
+
+            // decode the index back into the instructions
+            size_t div = 1;
+            for (size_t j = 1; j < width; j++)
+                div *= n;
+
+            for (size_t j = 0; j < width; j++) {
+                os << (j > 0 ? " / " : "") << inst_type_as_cstr((Inst_Type)((idxs[i] / div) % n));
+                div /= n;
+            }
+            os << std::endl;
+        }
+    };
+
+    dump("Instructions", inst_counts, 1);
+    dump("Instruction pairs", pair_counts, 2);
+    dump("Instruction triples", triple_counts, 3);
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::consume_fuel(const uint64_t insts) {
+    if (interrupted.load(std::memory_order_relaxed))
+        return Exception_Type::EXCEPTION_INTERRUPTED;
+
+    if (fuel < insts) {
+        fuel = 0;
+        return Exception_Type::EXCEPTION_OUT_OF_FUEL;
+    }
+
+    fuel -= insts;
+    return Exception_Type::EXCEPTION_OK;
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::next() {
+    // the debugger shows the output of each instruction right away
+    const Exception_Type exception = ip < current_program_size ? execute_instruction(image->insts.at(ip)) : end_of_code();
+    sync_output();
+    return exception;
+}
+
+template <typename Box>
+void Basic_Vm<Box>::sync_output() {
+    out.sync();
+    err.sync();
+}
+
+// little-endian loads and stores of 'size' bytes (independent of the host byte order)
+static inline uint64_t load_le(const uint8_t *const src, const size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+        value |= static_cast<uint64_t>(src[i]) << (8 * i);
+
+    return value;
+}
+
+static inline void store_le(uint8_t *const dst, const uint64_t value, const size_t size) {
+    for (size_t i = 0; i < size; i++)
+        dst[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+// gets the addr of an access of 'size' bytes, returns false if the access would go outside of the memory
+template <typename Box>
+bool Basic_Vm<Box>::mem_addr(const Box &ptr, const size_t size, size_t &addr) {
+    // check ptr type
+    if (ptr.get_type() != Nan_Type::PTR && ptr.get_type() != Nan_Type::INT)
+        return false;
+
+    // check 'ptr' value
+    if (ptr.get_type() == Nan_Type::INT && ptr.as_int() < 0)
+        return false;
+
+    addr = static_cast<size_t>(reinterpret_cast<uint64_t>(ptr.as_ptr()));
+    return addr < memory.size() && size <= memory.size() - addr;
+}
+
+// gets the size of a block of memory (an Int, 0 or bigger), returns false if it is not valid
+template <typename Box>
+bool Basic_Vm<Box>::mem_size(const Box &value, size_t &size) {
+    if (value.get_type() != Nan_Type::INT || value.as_int() < 0)
+        return false;
+
+    size = static_cast<size_t>(value.as_int());
+    return true;
+}
+
+// gets the addr of an array of 'n' vector elements, returns false if the array would go outside of the memory
+template <typename Box>
+bool Basic_Vm<Box>::vector_addr(const Box &ptr, const size_t n, size_t &addr) {
+    return n <= memory.size() / VECTOR_ELEMENT_SIZE && mem_addr(ptr, n * VECTOR_ELEMENT_SIZE, addr);
+}
+
+// the vector instructions (the stack was not checked), the arrays are processed by the kernels of the cpu (see 'vector_kernels')
+template <typename Box>
+template <typename T>
+Exception_Type Basic_Vm<Box>::execute_vector(const Inst_Type type, const Vector_Ops<T> &ops) {
+    uint8_t *const mem = memory.data();
+    size_t n, dst, a, b;
+
+    if (type == INST_VDOT) {
+        if (sp < 3)
+            return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+        if (!mem_size(stack[sp-1], n) || !vector_addr(stack[sp-3], n, a) || !vector_addr(stack[sp-2], n, b))
+            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+        stack[sp-3] = Box(ops.dot(mem + a, mem + b, n));
+        sp -= 2;
+        return Exception_Type::EXCEPTION_OK;
+    }
+
+    if (type == INST_VSUM || type == INST_VMIN || type == INST_VMAX) {
+        if (sp < 2)
+            return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+        if (!mem_size(stack[sp-1], n) || !vector_addr(stack[sp-2], n, a))
+            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+        // there is no min/max of an empty array
+        if (type == INST_VSUM)
+            stack[sp-2] = Box(ops.sum(mem + a, n));
+        else if (n == 0)
+            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+        else
+            stack[sp-2] = Box(type == INST_VMIN ? ops.min(mem + a, n) : ops.max(mem + a, n));
+
+        sp--;
+        return Exception_Type::EXCEPTION_OK;
+    }
+
+    // the element-wise instructions: dst, a, b (or the value for 'vscale') and n
+    if (sp < 4)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    if (!mem_size(stack[sp-1], n) || !vector_addr(stack[sp-4], n, dst) || !vector_addr(stack[sp-3], n, a))
+        return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+    if (type == INST_VSCALE) {
+        // the value is converted to the element type (like with 'td' and 'ti')
+        Box value = stack[sp-2];
+        if constexpr (std::is_floating_point_v<T>) {
+            cast_to_double(value);
+            ops.scale(mem + dst, mem + a, value.as_double(), n);
+        } else {
+            cast_to_int(value);
+            ops.scale(mem + dst, mem + a, value.as_int(), n);
+        }
+    } else {
+        if (!vector_addr(stack[sp-2], n, b))
+            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+        if (type == INST_VADD)
+            ops.add(mem + dst, mem + a, mem + b, n);
+        else if (type == INST_VSUB)
+            ops.sub(mem + dst, mem + a, mem + b, n);
+        else if (type == INST_VMUL)
+            ops.mul(mem + dst, mem + a, mem + b, n);
+        else if (type == INST_VFMA)
+            ops.fma(mem + dst, mem + a, mem + b, n);
+        else if (!ops.div(mem + dst, mem + a, mem + b, n))
+            return Exception_Type::EXCEPTION_DIV_BY_ZERO;
+    }
+
+    sp -= 4;
+    return Exception_Type::EXCEPTION_OK;
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::execute_instruction(const Inst& inst) {
+    // check for stack overflow
+    if (sp >= stack_cap)
+        return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
     switch (inst.type) {
     case Inst_Type::INST_NOP:
@@ -48,10 +410,10 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         return Exception_Type::EXCEPTION_OK;
 
     case Inst_Type::INST_PUSH:
-        if (sp >= STACK_CAP)
+        if (sp >= stack_cap)
             return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
-        stack[sp] = Nan_Box(inst.operand);
+        stack[sp] = Box(inst.operand);
         sp++;
         break;
 
@@ -127,7 +489,7 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
             return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
 
         sp--;
-        if (stack[sp] != Nan_Box(static_cast<int64_t>(0))) {
+        if (stack[sp] != Box(static_cast<int64_t>(0))) {
             ip = (uint64_t)inst.operand.as_ptr();
             return Exception_Type::EXCEPTION_OK;
         }
@@ -138,7 +500,7 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         if (sp < 1)
             return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
 
-        if (sp >= STACK_CAP)
+        if (sp >= stack_cap)
             return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
         if (sp-static_cast<size_t>(inst.operand.as_int()) <= 0)
@@ -163,7 +525,7 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         if (sp < 1)
             return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
 
-        if (sp >= STACK_CAP)
+        if (sp >= stack_cap)
             return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
         if (sp-static_cast<size_t>(inst.operand.as_int()) <= 0)
@@ -176,13 +538,13 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         break;
 
     case Inst_Type::INST_CALL:
-        if (sp >= STACK_CAP)
+        if (sp >= stack_cap)
             return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
         if (inst.operand.as_ptr() >= (void*)current_program_size)
             return Exception_Type::EXCEPTION_INVALID_JMP_ADDR;
 
-        stack[sp] = Nan_Box((void*)(ip+1));
+        stack[sp] = Box((void*)(ip+1));
         ip = (uint64_t)inst.operand.as_ptr();
         sp++;
         return Exception_Type::EXCEPTION_OK;
@@ -204,7 +566,8 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
             return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
 
         // call the native functions
-        (this->*native_funcs_addrs[inst.operand.as_int()])();
+        if (const Exception_Type exception = (this->*native_funcs_addrs[inst.operand.as_int()])(); exception != Exception_Type::EXCEPTION_OK)
+            return exception;
         break;
 
     case Inst_Type::INST_PRINT:
@@ -217,31 +580,7 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         if (sp-static_cast<size_t>(inst.operand.as_int()) > sp)
             return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
-        switch (stack[sp-static_cast<size_t>(inst.operand.as_int())-1].get_type()) {
-        case Nan_Type::DOUBLE:
-            std::cout << stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_double() << std::endl;
-            break;
-
-        case Nan_Type::INT:
-            std::cout << stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_int() << std::endl;
-            break;
-
-        case Nan_Type::PTR: {
-            const void *const ptr = stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_ptr();
-            const std::uintptr_t int_ptr = reinterpret_cast<std::uintptr_t>(ptr);
-            std::cout << std::hex << std::showbase << int_ptr << std::endl;
-            // taken from: https://www.tutorialspoint.com/cplusplus-program-to-print-values-in-a-specified-format
-            // std::cout << std::hex << std::showbase << ptr << std::endl;
-            // std::cout << std::hex << std::showbase << (long long) ptr << std::endl;
-            // std::cout << stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_ptr() << std::endl;
-            break;
-        }
-
-        case Nan_Type::EXCEPTION:
-        default:
-            std::cerr << "ERROR: Unknown variable data type in the stack." << std::endl;
-            exit(1);
-        }
+        print_value(stack[sp-static_cast<size_t>(inst.operand.as_int())-1]);
         break;
 
     case Inst_Type::INST_TD:
@@ -254,27 +593,7 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         if (sp-static_cast<size_t>(inst.operand.as_int()) > sp)
             return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
-        switch (stack[sp-static_cast<size_t>(inst.operand.as_int())-1].get_type()) {
-        case Nan_Type::INT:{
-            const double casted_value = (double)stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_int();
-            stack[sp-static_cast<size_t>(inst.operand.as_int())-1].box_double(casted_value);
-            break;
-        }
-
-        case Nan_Type::PTR: {
-            const double casted_value = (double)(int64_t)stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_ptr();
-            stack[sp-static_cast<size_t>(inst.operand.as_int())-1].box_double(casted_value);
-            break;
-        }
-
-        case Nan_Type::DOUBLE:
-            break;
-
-        case Nan_Type::EXCEPTION:
-        default:
-            std::cerr << "ERROR: Unknown variable data type in the stack." << std::endl;
-            exit(1);
-        }
+        cast_to_double(stack[sp-static_cast<size_t>(inst.operand.as_int())-1]);
         break;
 
     case Inst_Type::INST_TI:
@@ -287,27 +606,7 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         if (sp-static_cast<size_t>(inst.operand.as_int()) > sp)
             return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
-        switch (stack[sp-static_cast<size_t>(inst.operand.as_int())-1].get_type()) {
-        case Nan_Type::INT:
-            break;
-
-        case Nan_Type::PTR: {
-            const int64_t casted_value = (int64_t)stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_ptr();
-            stack[sp-static_cast<size_t>(inst.operand.as_int())-1].box_int(casted_value);
-            break;
-        }
-
-        case Nan_Type::DOUBLE: {
-            const int64_t casted_value = (int64_t)stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_double();
-            stack[sp-static_cast<size_t>(inst.operand.as_int())-1].box_int(casted_value);
-            break;
-        }
-
-        case Nan_Type::EXCEPTION:
-        default:
-            std::cerr << "ERROR: Unknown variable data type in the stack." << std::endl;
-            exit(1);
-        }
+        cast_to_int(stack[sp-static_cast<size_t>(inst.operand.as_int())-1]);
         break;
 
     case Inst_Type::INST_TP:
@@ -320,27 +619,7 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         if (sp-static_cast<size_t>(inst.operand.as_int()) > sp)
             return Exception_Type::EXCEPTION_STACK_OVERFLOW;
 
-        switch (stack[sp-static_cast<size_t>(inst.operand.as_int())-1].get_type()) {
-        case Nan_Type::INT: {
-            const void *casted_value = (void *)stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_int();
-            stack[sp-static_cast<size_t>(inst.operand.as_int())-1].box_ptr(casted_value);
-            break;
-        }
-
-        case Nan_Type::PTR:
-            break;
-
-        case Nan_Type::DOUBLE: {
-            const void *casted_value = (void *)(uint64_t)stack[sp-static_cast<size_t>(inst.operand.as_int())-1].as_double();
-            stack[sp-static_cast<size_t>(inst.operand.as_int())-1].box_ptr(casted_value);
-            break;
-        }
-
-        case Nan_Type::EXCEPTION:
-        default:
-            std::cerr << "ERROR: Unknown variable data type in the stack." << std::endl;
-            exit(1);
-        }
+        cast_to_ptr(stack[sp-static_cast<size_t>(inst.operand.as_int())-1]);
         break;
 
     case Inst_Type::INST_SHL:
@@ -407,7 +686,7 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         break;
 
     case INST_READ: {
-        if (sp < 2)
+        if (sp < 1)
             return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
 
         // check the 'read size'
@@ -415,26 +694,12 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         if ((read_size != 8) && (read_size != 16) && (read_size != 32) && (read_size != 64))
             return Exception_Type::EXCEPTION_INVALID_READ_WRITE_SIZE;
 
-        // check ptr type
-        if (stack[sp-1].get_type() != Nan_Type::PTR && stack[sp-1].get_type() != Nan_Type::INT)
+        size_t addr;
+        if (!mem_addr(stack[sp-1], static_cast<size_t>(read_size / 8), addr))
             return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
 
-        // check 'ptr' value
-        if (stack[sp-1].get_type() == Nan_Type::INT && stack[sp-1].as_int() < 0)
-            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
-
-        // check 'ptr' value
-        if ((uint64_t)stack[sp-1].as_ptr() >= program.memory.size())
-            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
-
-        // get a byte from a double in the static memory (not sure if this will ever be used)
-        if (program.memory[static_cast<size_t>(stack[sp-1].as_int())].get_type() == Nan_Type::DOUBLE) {
-            double value = program.memory[static_cast<size_t>(stack[sp-1].as_int())].as_double();
-            const uint64_t *const new_value = (uint64_t*)(&value);
-            stack[sp-1] = CAST_TO_SIZE(read_size, *new_value);
-        } else {
-            stack[sp-1] = CAST_TO_SIZE(read_size, program.memory[static_cast<size_t>(stack[sp-1].as_int())].as_int());
-        }
+        // the value is sign extended from the read size
+        stack[sp-1] = CAST_TO_SIZE(read_size, load_le(&memory[addr], static_cast<size_t>(read_size / 8)));
         break;
     }
 
@@ -447,30 +712,129 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
         if ((write_size != 8) && (write_size != 16) && (write_size != 32) && (write_size != 64))
             return Exception_Type::EXCEPTION_INVALID_READ_WRITE_SIZE;
 
-        // check ptr type
-        if (stack[sp-2].get_type() != Nan_Type::PTR && stack[sp-2].get_type() != Nan_Type::INT)
+        size_t addr;
+        if (!mem_addr(stack[sp-2], static_cast<size_t>(write_size / 8), addr))
+            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+        // a double is written as its bits (use 'writef' to store a double)
+        const uint64_t value = stack[sp-1].get_type() == Nan_Type::DOUBLE ? std::bit_cast<uint64_t>(stack[sp-1].as_double()) : static_cast<uint64_t>(stack[sp-1].as_int());
+        store_le(&memory[addr], value, static_cast<size_t>(write_size / 8));
+        sp -= 2;
+        break;
+    }
+
+    case INST_READF: {
+        if (sp < 1)
+            return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+        size_t addr;
+        if (!mem_addr(stack[sp-1], sizeof(double), addr))
+            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+        stack[sp-1] = Box(std::bit_cast<double>(load_le(&memory[addr], sizeof(double))));
+        break;
+    }
+
+    case INST_WRITEF: {
+        if (sp < 2)
+            return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+        size_t addr;
+        if (!mem_addr(stack[sp-2], sizeof(double), addr))
             return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
 
-        // check 'ptr' value
-        if (stack[sp-2].get_type() == Nan_Type::INT && stack[sp-2].as_int() < 0)
+        // the value is converted to a double (like with 'td')
+        Box value = stack[sp-1];
+        cast_to_double(value);
+        store_le(&memory[addr], std::bit_cast<uint64_t>(value.as_double()), sizeof(double));
+        sp -= 2;
+        break;
+    }
+
+    case INST_COPY: {
+        if (sp < 3)
+            return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+        size_t size, dst, src;
+        if (!mem_size(stack[sp-1], size) || !mem_addr(stack[sp-3], size, dst) || !mem_addr(stack[sp-2], size, src))
             return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
 
-        // check ptr value
-        if ((uint64_t)stack[sp-2].as_ptr() >= program.memory.size())
+        // the libc functions use the widest vector instructions of the cpu
+        std::memmove(memory.data() + dst, memory.data() + src, size);
+        sp -= 3;
+        break;
+    }
+
+    case INST_FILL: {
+        if (sp < 3)
+            return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+        size_t size, dst;
+        if (!mem_size(stack[sp-1], size) || !mem_addr(stack[sp-3], size, dst))
             return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
 
-        // get a byte from a double in the stack (not shure if this will ever be used)
-        if (stack[sp-1].get_type() == Nan_Type::DOUBLE) {
-            const double value = stack[sp-1].as_double();
-            const uint64_t *const new_value = (uint64_t*)(&value);
-            program.memory[static_cast<size_t>(stack[sp-2].as_int())] = CAST_TO_SIZE(write_size, *new_value);
-        } else {
-            program.memory[static_cast<size_t>(stack[sp-2].as_int())] = CAST_TO_SIZE(write_size, stack[sp-1].as_int());
-        }
+        // only the lowest byte of the value is used
+        std::memset(memory.data() + dst, static_cast<uint8_t>(stack[sp-2].as_int()), size);
+        sp -= 3;
+        break;
+    }
+
+    case INST_COMPARE: {
+        if (sp < 3)
+            return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+        size_t size, lhs, rhs;
+        if (!mem_size(stack[sp-1], size) || !mem_addr(stack[sp-3], size, lhs) || !mem_addr(stack[sp-2], size, rhs))
+            return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+        const int result = size == 0 ? 0 : std::memcmp(memory.data() + lhs, memory.data() + rhs, size);
+        stack[sp-3] = static_cast<int64_t>((result > 0) - (result < 0));
         sp -= 2;
         break;
     }
 
+    case INST_VADD:
+    case INST_VSUB:
+    case INST_VMUL:
+    case INST_VDIV:
+    case INST_VFMA:
+    case INST_VSCALE:
+    case INST_VDOT:
+    case INST_VSUM:
+    case INST_VMIN:
+    case INST_VMAX: {
+        Exception_Type exception;
+        switch (inst.operand.as_int()) {
+        case VECTOR_F64:
+            exception = execute_vector(inst.type, vector_kernels().f64);
+            break;
+
+        case VECTOR_I64:
+            exception = execute_vector(inst.type, vector_kernels().i64);
+            break;
+
+        default:
+            return Exception_Type::EXCEPTION_INVALID_VECTOR_TYPE;
+        }
+
+        if (exception != Exception_Type::EXCEPTION_OK)
+            return exception;
+        break;
+    }
+
+    // these change the current coroutine (and 'ip')
+    case INST_SPAWN:
+        return spawn_coroutine((uint64_t)inst.operand.as_ptr());
+
+    case INST_YIELD:
+        return yield_coroutine();
+
+    case INST_JOIN:
+        return join_coroutine();
+
+    case INST_SLEEP:
+        return sleep_coroutine();
+
     case Inst_Type::INST_COUNT:
     default:
         return Exception_Type::EXCEPTION_UNKNOWN_INSTRUCTION;
@@ -478,15 +842,107 @@ Exception_Type Vm::execute_instruction(Inst& inst) {
 
     ip++;
 
-    // check for exceptions in the nan types
-    if (stack[sp-1].get_type() == Nan_Type::EXCEPTION)
+    // check for exceptions in the nan types (the stack might be empty after a 'pop')
+    if (sp > 0 && stack[sp-1].get_type() == Nan_Type::EXCEPTION)
         return stack[sp-1].as_exception();
 
     // nothing went wrong
     return Exception_Type::EXCEPTION_OK;
 }
 
-void Vm::dump_stack() {
+template <typename Box>
+void Basic_Vm<Box>::print_value(Box &value) {
+    switch (value.get_type()) {
+    case Nan_Type::DOUBLE:
+        out.write_double(value.as_double());
+        break;
+
+    case Nan_Type::INT:
+        out.write_int(value.as_int());
+        break;
+
+    case Nan_Type::PTR:
+        out.write_ptr(reinterpret_cast<std::uintptr_t>(value.as_ptr()));
+        break;
+
+    case Nan_Type::EXCEPTION:
+    default:
+        sync_output();
+        std::cerr << "ERROR: Unknown variable data type in the stack." << std::endl;
+        exit(1);
+    }
+
+    out.put('\n');
+}
+
+// type casting functions (used by the 'td', 'ti' and 'tp' instructions)
+
+template <typename Box>
+void Basic_Vm<Box>::cast_to_double(Box &value) {
+    switch (value.get_type()) {
+    case Nan_Type::INT:
+        value.box_double((double)value.as_int());
+        break;
+
+    case Nan_Type::PTR:
+        value.box_double((double)(int64_t)value.as_ptr());
+        break;
+
+    case Nan_Type::DOUBLE:
+        break;
+
+    case Nan_Type::EXCEPTION:
+    default:
+        std::cerr << "ERROR: Unknown variable data type in the stack." << std::endl;
+        exit(1);
+    }
+}
+
+template <typename Box>
+void Basic_Vm<Box>::cast_to_int(Box &value) {
+    switch (value.get_type()) {
+    case Nan_Type::INT:
+        break;
+
+    case Nan_Type::PTR:
+        value.box_int((int64_t)value.as_ptr());
+        break;
+
+    case Nan_Type::DOUBLE:
+        value.box_int((int64_t)value.as_double());
+        break;
+
+    case Nan_Type::EXCEPTION:
+    default:
+        std::cerr << "ERROR: Unknown variable data type in the stack." << std::endl;
+        exit(1);
+    }
+}
+
+template <typename Box>
+void Basic_Vm<Box>::cast_to_ptr(Box &value) {
+    switch (value.get_type()) {
+    case Nan_Type::INT:
+        value.box_ptr((void *)value.as_int());
+        break;
+
+    case Nan_Type::PTR:
+        break;
+
+    case Nan_Type::DOUBLE:
+        value.box_ptr((void *)(uint64_t)value.as_double());
+        break;
+
+    case Nan_Type::EXCEPTION:
+    default:
+        std::cerr << "ERROR: Unknown variable data type in the stack." << std::endl;
+        exit(1);
+    }
+}
+
+template <typename Box>
+void Basic_Vm<Box>::dump_stack() {
+    sync_output();
     // print the stack
     std::cout << "Vm Stack (" << sp << " element" << (sp != 1 ? "s" : "") << "):" << std::endl;
     for (size_t i = 0; i < sp; i++) {
@@ -514,90 +970,307 @@ void Vm::dump_stack() {
         std::cout << "    [Empty]" << std::endl;
 }
 
-void Vm::dump_memory() {
-    // print the memory
-    std::cout << "Vm Memory (" << program.memory.size() << " element" << (program.memory.size() != 1 ? "s" : "") << "):" << std::endl;
-    for (size_t i = 0; i < program.memory.size(); i++) {
-        switch (program.memory[i].get_type()) {
-        case Nan_Type::DOUBLE:
-            std::cout << "    # Double: " << program.memory[i].as_double() << std::endl;
-            break;
+template <typename Box>
+void Basic_Vm<Box>::dump_memory() {
+    sync_output();
+    // print the memory (16 bytes per line, in hex)
+    std::cout << "Vm Memory (" << memory.size() << " byte" << (memory.size() != 1 ? "s" : "") << "):" << std::endl;
+    dump_bytes(std::cout, memory.bytes(), 0, memory.size());
 
-        case Nan_Type::INT:
-            std::cout << "    # Int: " << program.memory[i].as_int() << std::endl;
-            break;
+    if (memory.size() == 0)
+        std::cout << "    [Empty]" << std::endl;
+}
 
-        case Nan_Type::PTR:
-            std::cout << "    # Ptr: " << program.memory[i].as_ptr() << std::endl;
-            break;
+template <typename Box>
+void Basic_Vm<Box>::dump_bytes(std::ostream &os, const std::span<const uint8_t> bytes, const size_t begin, const size_t end) {
+    const std::ios_base::fmtflags flags = os.flags();
+    const char fill = os.fill();
 
-        case Nan_Type::EXCEPTION:
-        default:
-            std::cerr << "ERROR: Unknown variable data type in the memory." << std::endl;
-            exit(1);
+    for (size_t line = begin; line < end; line += 16) {
+        const size_t line_end = std::min(line + 16, end);
+        os << "    " << std::hex << std::setfill('0') << std::setw(8) << line << ":";
+
+        for (size_t i = line; i < line + 16; i++) {
+            if (i < line_end)
+                os << " " << std::setw(2) << static_cast<unsigned>(bytes[i]);
+            else
+                os << "   ";
         }
+
+        // the printable characters
+        os << "  |";
+        for (size_t i = line; i < line_end; i++)
+            os << (std::isprint(bytes[i]) ? static_cast<char>(bytes[i]) : '.');
+        os << "|" << std::endl;
     }
 
-    if (program.memory.size() == 0)
-        std::cout << "    [Empty]" << std::endl;
+    os.flags(flags);
+    os.fill(fill);
 }
 
 // native functions
 // WARNING: we assume that the state of the machine was checked before calling this native functions
 
-void Vm::native_malloc() {
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_malloc() {
     // get the size of the memory to allocate
     const size_t size = static_cast<size_t>(stack[sp-1].as_int());
 
-    // allocate the memory
-    const void *const ptr = malloc(size);
+    // allocate the memory in the vm heap (0 if there is no memory left)
+    const uint64_t addr = heap.allocate(size);
 
-    // store the pointer in the stack
-    stack[sp-1].box_ptr(ptr);
+    // store the pointer (offset in the vm memory) in the stack
+    stack[sp-1].box_ptr(reinterpret_cast<void*>(addr));
+    return Exception_Type::EXCEPTION_OK;
 }
 
-void Vm::native_free() {
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_free() {
     // get the pointer to free
-    void *const ptr = stack[sp-1].as_ptr();
+    const uint64_t addr = reinterpret_cast<uint64_t>(stack[sp-1].as_ptr());
 
     // free the memory
-    free(ptr);
+    if (!heap.release(addr))
+        return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
 
     // comsume the addr
     sp--;
+    return Exception_Type::EXCEPTION_OK;
 }
 
-void Vm::native_fwrite() {
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_fwrite() {
+    if (sp < 3)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
     // get the string size
     const size_t str_size = static_cast<size_t>(stack[sp-2].as_int());
 
-    // get the string (convert from Nan_Box to char)
-    std::vector<char> buf;
-    buf.reserve(str_size);
-    for (size_t i = 0; i < str_size; i++) {
-        buf.push_back(static_cast<char>(program.memory[static_cast<size_t>(stack[sp-1].as_int())+i].as_int()));
-    }
+    // get the string (the memory already holds the bytes)
+    size_t addr;
+    if (!mem_addr(stack[sp-1], str_size, addr))
+        return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
 
-    // get the file 'pointer'
-    FILE *file_ptr;
-    switch (stack[sp-3].as_int()) {
-    case 0:
-        file_ptr = stdin;
-        break;
+    const char *const buf = reinterpret_cast<const char*>(memory.data()) + addr;
 
+    // get the output (3 was used for stderr by older programs)
+    Output *output;
+    switch (stack[sp-3].as_int()) {
     case 1:
-        file_ptr = stdout;
+        output = &out;
         break;
 
+    case 2:
     case 3:
-        file_ptr = stderr;
+        output = &err;
         break;
 
     default:
-        std::cerr << "ERROR: Invalid file descriptor." << std::endl;
-        exit(1);
+        return Exception_Type::EXCEPTION_INVALID_FD;
     }
 
     // make the native function call
-    fwrite(buf.data(), 1, str_size, file_ptr);
+    output->write(buf, str_size);
+    return Exception_Type::EXCEPTION_OK;
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_fread() {
+    if (sp < 3)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    // only stdin can be read
+    if (stack[sp-3].as_int() != 0)
+        return Exception_Type::EXCEPTION_INVALID_FD;
+
+    // get the buffer
+    size_t size, addr;
+    if (!mem_size(stack[sp-2], size) || !mem_addr(stack[sp-1], size, addr))
+        return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+    size_t read;
+    if (has_input) {
+        read = std::min(size, input.size());
+        std::memcpy(memory.data() + addr, input.data(), read);
+        input.remove_prefix(read);
+    } else {
+        // a prompt written before has to be seen before blocking
+        sync_output();
+        read = std::fread(memory.data() + addr, 1, size, stdin);
+    }
+
+    // the buffer is replaced by the number of bytes read (0 at the end of the input)
+    stack[sp-1] = Box(static_cast<int64_t>(read));
+    return Exception_Type::EXCEPTION_OK;
+}
+
+// the path is a string in memory, the mode is 0 (read), 1 (write, the file is created or truncated) or 2 (read and write)
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_fopen() {
+    if (sp < 3)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    size_t size, addr;
+    if (!mem_size(stack[sp-2], size) || !mem_addr(stack[sp-1], size, addr))
+        return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+    const std::string path(reinterpret_cast<const char*>(memory.data()) + addr, size);
+    const int64_t mode = stack[sp-3].as_int();
+    const int64_t handle = mode >= IO_MODE_READ && mode <= IO_MODE_READ_WRITE ? io.open(path, static_cast<Io_Mode>(mode)) : -EINVAL;
+
+    // the arguments are replaced by the handle of the file (or '-errno')
+    sp -= 2;
+    stack[sp-1] = Box(handle);
+    return Exception_Type::EXCEPTION_OK;
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_fclose() {
+    if (sp < 1)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    // the handle is replaced by 0 (or '-errno')
+    stack[sp-1] = Box(io.close(stack[sp-1].as_int()));
+    return Exception_Type::EXCEPTION_OK;
+}
+
+// queues a read/write of the buffer at an offset of the file, the arguments are replaced by the id of the request (or '-errno')
+template <typename Box>
+Exception_Type Basic_Vm<Box>::queue_io(const Io_Op op) {
+    if (sp < 4)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    size_t size, addr, offset;
+    if (!mem_size(stack[sp-2], size) || !mem_addr(stack[sp-1], size, addr))
+        return Exception_Type::EXCEPTION_INVALID_MEM_ADDR;
+
+    if (!mem_size(stack[sp-3], offset))
+        return Exception_Type::EXCEPTION_INVALID_READ_WRITE_SIZE;
+
+    // the address of the buffer is kept with the request, the data of a read is copied there by 'await'
+    const int64_t id = io.queue(op, stack[sp-4].as_int(), offset, memory.data() + addr, size, addr);
+
+    sp -= 3;
+    stack[sp-1] = Box(id);
+    return Exception_Type::EXCEPTION_OK;
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_aread() {
+    return queue_io(IO_READ);
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_awrite() {
+    return queue_io(IO_WRITE);
+}
+
+// sends the queued requests, the number of requests to wait for is replaced by the number of requests sent
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_asubmit() {
+    if (sp < 1)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    size_t wait;
+    if (!mem_size(stack[sp-1], wait))
+        wait = 0;
+
+    stack[sp-1] = Box(static_cast<int64_t>(io.submit(wait)));
+    return Exception_Type::EXCEPTION_OK;
 }
+
+template <typename Box>
+bool Basic_Vm<Box>::io_request(const Box &value, uint64_t &id) {
+    if (value.get_type() != Nan_Type::INT || value.as_int() < 0)
+        return false;
+
+    id = static_cast<uint64_t>(value.as_int());
+    return io.valid(id);
+}
+
+// the id is replaced by 1 if the request is done, 0 otherwise (never blocks)
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_apoll() {
+    if (sp < 1)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    uint64_t id;
+    if (!io_request(stack[sp-1], id))
+        return Exception_Type::EXCEPTION_INVALID_IO_REQUEST;
+
+    stack[sp-1] = Box(static_cast<int64_t>(io.poll(id)));
+    return Exception_Type::EXCEPTION_OK;
+}
+
+// waits for a request, the id is replaced by the result (bytes read/written or '-errno') and can be reused by a new request
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_await() {
+    if (sp < 1)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    uint64_t id;
+    if (!io_request(stack[sp-1], id))
+        return Exception_Type::EXCEPTION_INVALID_IO_REQUEST;
+
+    // a prompt written before has to be seen before blocking
+    if (!io.poll(id))
+        sync_output();
+
+    io.wait(id);
+    const int64_t result = io.result(id);
+
+    // the memory only grows during a run, so the buffer is still there
+    if (io.op(id) == IO_READ && result > 0)
+        std::memcpy(memory.data() + io.tag(id), io.data(id).data(), static_cast<size_t>(result));
+
+    io.release(id);
+    stack[sp-1] = Box(result);
+    return Exception_Type::EXCEPTION_OK;
+}
+
+// the top of the stack is replaced by 0, or by 1 in the runs started from the snapshot (the state is saved with the 1)
+template <typename Box>
+Exception_Type Basic_Vm<Box>::native_snapshot() {
+    if (sp < 1)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    if (snapshot_output.empty()) {
+        stack[sp-1] = Box(static_cast<int64_t>(0));
+        return Exception_Type::EXCEPTION_OK;
+    }
+
+    // the other coroutines and the files cannot be saved
+    for (size_t id = 1; id < coroutines.size(); id++) {
+        if (coroutines[id].state != COROUTINE_DONE) {
+            sync_output();
+            std::cerr << "ERROR: Could not save the snapshot, there are coroutines running." << std::endl;
+            return Exception_Type::EXCEPTION_SNAPSHOT_FAILED;
+        }
+    }
+
+    if (io.has_open_files()) {
+        sync_output();
+        std::cerr << "ERROR: Could not save the snapshot, there are open files." << std::endl;
+        return Exception_Type::EXCEPTION_SNAPSHOT_FAILED;
+    }
+
+    stack[sp-1] = Box(static_cast<int64_t>(1));
+    std::vector<Nan_Box> saved_stack(sp);
+    for (size_t i = 0; i < sp; i++)
+        saved_stack[i] = Nan_Box(stack[i]);
+
+    std::vector<uint64_t> heap_words;
+    heap.save(heap_words);
+
+    if (!Snapshot::write(snapshot_output.c_str(), image->fingerprint, ip + 1, saved_stack, memory.bytes(), heap_words)) {
+        sync_output();
+        std::cerr << "ERROR: An error occured when trying to write a snapshot to '" << snapshot_output << "'" << std::endl;
+        return Exception_Type::EXCEPTION_SNAPSHOT_FAILED;
+    }
+
+    // the setup is done
+    return Exception_Type::EXCEPTION_EXIT;
+}
+
+template class Basic_Vm<Nan_Box>;
+template class Basic_Vm<Int_Box>;
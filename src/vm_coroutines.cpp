@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <thread>
+
+#include "vm.h"
+
+/*
+ The coroutine scheduler of the vm (see 'Basic_Vm::Coroutine').
+
+ Switching coroutines copies the values of the current one out of the vm stack and the values of the next one into it.
+ Coroutines are meant to be shallow (a few values each), so this is cheaper than giving each one its own stack region and
+ lets tens of thousands of them be suspended at the same time. The ready coroutines run in the order they became ready.
+ */
+
+template <typename Box>
+void Basic_Vm<Box>::reset_coroutines() {
+    coroutines.clear();
+    coroutines.push_back(Coroutine {COROUTINE_RUNNING, 0, {}, {}, Box(static_cast<int64_t>(0))});
+    current_coroutine = 0;
+    ready_coroutines.clear();
+    sleeping_coroutines = {};
+}
+
+// the argument on top of the stack is replaced by the id of the new coroutine
+template <typename Box>
+Exception_Type Basic_Vm<Box>::spawn_coroutine(const uint64_t entry) {
+    if (sp < 1)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    if (entry >= current_program_size)
+        return Exception_Type::EXCEPTION_INVALID_JMP_ADDR;
+
+    // the entry function returns to the end of the code (see 'end_of_code')
+    const uint64_t id = coroutines.size();
+    const Box ret_addr = Box(reinterpret_cast<void*>(current_program_size));
+    coroutines.push_back(Coroutine {COROUTINE_READY, entry, {stack[sp-1], ret_addr}, {}, Box(static_cast<int64_t>(0))});
+    ready_coroutines.push_back(id);
+
+    stack[sp-1] = Box(static_cast<int64_t>(id));
+    ip++;
+    return Exception_Type::EXCEPTION_OK;
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::yield_coroutine() {
+    ip++;
+
+    // nothing else to run
+    if (ready_coroutines.empty() && sleeping_coroutines.empty())
+        return Exception_Type::EXCEPTION_OK;
+
+    coroutines[current_coroutine].state = COROUTINE_READY;
+    ready_coroutines.push_back(current_coroutine);
+    return switch_coroutine();
+}
+
+// the id on top of the stack is replaced by the result of the coroutine (when it ends)
+template <typename Box>
+Exception_Type Basic_Vm<Box>::join_coroutine() {
+    if (sp < 1)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    if (stack[sp-1].get_type() != Nan_Type::INT || stack[sp-1].as_int() < 0 || static_cast<uint64_t>(stack[sp-1].as_int()) >= coroutines.size())
+        return Exception_Type::EXCEPTION_INVALID_COROUTINE;
+
+    const uint64_t id = static_cast<uint64_t>(stack[sp-1].as_int());
+    if (id == current_coroutine)
+        return Exception_Type::EXCEPTION_DEADLOCK;
+
+    ip++;
+    Coroutine &coroutine = coroutines[id];
+    if (coroutine.state == COROUTINE_DONE) {
+        stack[sp-1] = coroutine.result;
+        return Exception_Type::EXCEPTION_OK;
+    }
+
+    coroutine.joiners.push_back(current_coroutine);
+    coroutines[current_coroutine].state = COROUTINE_JOINING;
+    return switch_coroutine();
+}
+
+// takes the number of milliseconds from the stack (converted to an Int, like with 'ti')
+template <typename Box>
+Exception_Type Basic_Vm<Box>::sleep_coroutine() {
+    if (sp < 1)
+        return Exception_Type::EXCEPTION_STACK_UNDERFLOW;
+
+    Box value = stack[sp-1];
+    cast_to_int(value);
+    const auto wake_up = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max<int64_t>(value.as_int(), 0));
+    sp--;
+    ip++;
+
+    coroutines[current_coroutine].state = COROUTINE_SLEEPING;
+    sleeping_coroutines.push(Sleeper {wake_up, current_coroutine});
+    return switch_coroutine();
+}
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::end_of_code() {
+    if (current_coroutine == 0)
+        return Exception_Type::EXCEPTION_EXIT;
+
+    Coroutine &coroutine = coroutines[current_coroutine];
+    coroutine.state = COROUTINE_DONE;
+    coroutine.result = sp > 0 ? stack[sp-1] : Box(static_cast<int64_t>(0));
+
+    // the joiners get the result in place of the id (still on top of their stacks)
+    for (const uint64_t joiner: coroutine.joiners) {
+        coroutines[joiner].stack.back() = coroutine.result;
+        coroutines[joiner].state = COROUTINE_READY;
+        ready_coroutines.push_back(joiner);
+    }
+
+    std::vector<uint64_t>().swap(coroutine.joiners);
+    std::vector<Box>().swap(coroutine.stack);
+    return switch_coroutine();
+}
+
+// runs the next ready coroutine (the current one must already be out of the running state)
+template <typename Box>
+Exception_Type Basic_Vm<Box>::switch_coroutine() {
+    for (;;) {
+        if (!sleeping_coroutines.empty()) {
+            const auto now = std::chrono::steady_clock::now();
+            while (!sleeping_coroutines.empty() && sleeping_coroutines.top().first <= now) {
+                const uint64_t id = sleeping_coroutines.top().second;
+                sleeping_coroutines.pop();
+                coroutines[id].state = COROUTINE_READY;
+                ready_coroutines.push_back(id);
+            }
+
+            if (ready_coroutines.empty()) {
+                // nothing can run until the first sleeper wakes up (waits in slices to see the interrupts)
+                if (interrupted.load(std::memory_order_relaxed))
+                    return Exception_Type::EXCEPTION_INTERRUPTED;
+
+                std::this_thread::sleep_until(std::min(sleeping_coroutines.top().first, now + SLEEP_SLICE));
+                continue;
+            }
+        }
+
+        // every coroutine is waiting for another one
+        if (ready_coroutines.empty())
+            return Exception_Type::EXCEPTION_DEADLOCK;
+
+        break;
+    }
+
+    const uint64_t next = ready_coroutines.front();
+    ready_coroutines.pop_front();
+
+    if (next != current_coroutine) {
+        Coroutine &from = coroutines[current_coroutine];
+        if (from.state != COROUTINE_DONE) {
+            from.stack.assign(stack, stack + sp);
+            from.ip = ip;
+        }
+
+        // the saved stack always fits (it came from the vm stack, or it is a new coroutine)
+        Coroutine &to = coroutines[next];
+        std::copy(to.stack.begin(), to.stack.end(), stack);
+        sp = to.stack.size();
+        ip = to.ip;
+        to.stack.clear(); // keeps the capacity for the next time it is suspended
+
+        current_coroutine = next;
+    }
+
+    coroutines[current_coroutine].state = COROUTINE_RUNNING;
+    return Exception_Type::EXCEPTION_OK;
+}
+
+template void Basic_Vm<Nan_Box>::reset_coroutines();
+template void Basic_Vm<Int_Box>::reset_coroutines();
+template Exception_Type Basic_Vm<Nan_Box>::spawn_coroutine(uint64_t);
+template Exception_Type Basic_Vm<Int_Box>::spawn_coroutine(uint64_t);
+template Exception_Type Basic_Vm<Nan_Box>::yield_coroutine();
+template Exception_Type Basic_Vm<Int_Box>::yield_coroutine();
+template Exception_Type Basic_Vm<Nan_Box>::join_coroutine();
+template Exception_Type Basic_Vm<Int_Box>::join_coroutine();
+template Exception_Type Basic_Vm<Nan_Box>::sleep_coroutine();
+template Exception_Type Basic_Vm<Int_Box>::sleep_coroutine();
+template Exception_Type Basic_Vm<Nan_Box>::end_of_code();
+template Exception_Type Basic_Vm<Int_Box>::end_of_code();
+template Exception_Type Basic_Vm<Nan_Box>::switch_coroutine();
+template Exception_Type Basic_Vm<Int_Box>::switch_coroutine();
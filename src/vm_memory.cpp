@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+#include "vm_memory.h"
+#include "memory_region.h"
+
+#ifndef _WIN32
+    #include <sys/mman.h>
+#endif
+
+// below this many bytes, zeroing with 'memset' is cheaper than giving the pages back
+#define CLEAR_WITH_MEMSET (64 * 1024)
+
+Vm_Memory::~Vm_Memory() {
+#ifdef _WIN32
+    std::free(base);
+#else
+    if (base != nullptr)
+        munmap(base, capacity);
+#endif
+}
+
+bool Vm_Memory::reserve(const size_t size) {
+    if (size <= capacity)
+        return true;
+
+    const size_t page = Memory_Region::page_size();
+    if (size > SIZE_MAX / 2)
+        return false;
+
+    const size_t new_capacity = (std::max(size, capacity * 2) + page - 1) / page * page;
+
+#ifdef _WIN32
+    uint8_t *const new_base = static_cast<uint8_t*>(std::realloc(base, new_capacity));
+    if (new_base != nullptr)
+        std::memset(new_base + capacity, 0, new_capacity - capacity);
+#elif defined(__linux__)
+    // the pages are moved, not copied
+    void *const mapping = base == nullptr ? mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)
+                                          : mremap(base, capacity, new_capacity, MREMAP_MAYMOVE);
+    uint8_t *const new_base = mapping != MAP_FAILED ? static_cast<uint8_t*>(mapping) : nullptr;
+#else
+    void *const mapping = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    uint8_t *const new_base = mapping != MAP_FAILED ? static_cast<uint8_t*>(mapping) : nullptr;
+    if (new_base != nullptr && base != nullptr) {
+        std::memcpy(new_base, base, used);
+        munmap(base, capacity);
+    }
+#endif
+
+    if (new_base == nullptr)
+        return false;
+
+    base = new_base;
+    capacity = new_capacity;
+    return true;
+}
+
+void Vm_Memory::clear(const size_t begin, const size_t end) {
+#ifdef __linux__
+    // the whole pages are given back (they read as zero when touched again)
+    const size_t page = Memory_Region::page_size();
+    const size_t first_page = (begin + page - 1) / page * page, last_page = end / page * page;
+    if (end - begin >= CLEAR_WITH_MEMSET && first_page < last_page && madvise(base + first_page, last_page - first_page, MADV_DONTNEED) == 0) {
+        std::memset(base + begin, 0, first_page - begin);
+        std::memset(base + last_page, 0, end - last_page);
+        return;
+    }
+#endif
+
+    std::memset(base + begin, 0, end - begin);
+}
+
+bool Vm_Memory::resize(const size_t size) {
+    if (size > used && !reserve(size))
+        return false;
+    else if (size < used)
+        clear(size, used);
+
+    used = size;
+    return true;
+}
+
+bool Vm_Memory::assign(const std::span<const uint8_t> bytes, const size_t zeros) {
+    if (zeros > SIZE_MAX - bytes.size() || !reserve(bytes.size() + zeros))
+        return false;
+
+    resize(bytes.size());
+    if (!bytes.empty())
+        std::memcpy(base, bytes.data(), bytes.size());
+
+    return resize(bytes.size() + zeros);
+}
@@ -0,0 +1,638 @@
+#include <iostream>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+
+#include "vm.h"
+
+/*
+ The threaded interpreter loop.
+
+ Every handler jumps straight to the handler of the next instruction instead of returning to a central loop.
+ With GCC/Clang this is done with 'labels as values' (computed goto), which gives each handler its own indirect
+ branch (much easier on the branch predictor). Other compilers get a plain 'switch' inside a loop.
+ The instruction and stack pointers, as well as the stack base, are kept in locals and only written back to the
+ vm when leaving the loop or when calling code that needs them (natives, debug functions).
+
+ Fuel is not charged per instruction: the instructions run since the start of the current basic block are charged
+ (and the interrupt flag is checked) only when the control flow changes, so straight-line code runs without checks.
+
+ The loop runs on the pre-decoded program ('Code'), so there is no operand unboxing and no jump target validation
+ at runtime and, thanks to the 'exit' appended at the end of the code, no check for the end of the program.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+    #define USE_COMPUTED_GOTO
+#endif
+
+#ifdef USE_COMPUTED_GOTO
+    #define INST_CASE(inst) L_##inst:
+    #define DISPATCH() goto *dispatch_table[ops[ip]]
+#else
+    // a 'goto' instead of 'continue' so it can be used inside the 'do { } while (0)' macros
+    #define INST_CASE(inst) case inst:
+    #define DISPATCH() goto dispatch
+#endif
+
+// write the local state back to the vm and leave the loop
+#define RAISE(exception)   \
+    do {                   \
+        this->ip = ip;     \
+        this->sp = sp;     \
+        this->fuel = fuel; \
+        return exception;  \
+    } while (0)
+
+// same check as in 'execute_instruction' but only done after the instructions that can produce an exception value
+#define CHECK_NAN_EXCEPTION()                                   \
+    do {                                                        \
+        if (stack[sp-1].get_type() == Nan_Type::EXCEPTION)      \
+            RAISE(stack[sp-1].as_exception());                  \
+    } while (0)
+
+#define BINARY_OP(op)                                         \
+    do {                                                      \
+        CHECK_UNDERFLOW(2);                                   \
+                                                              \
+        stack[sp-2] op stack[sp-1];                           \
+        sp--;                                                 \
+        ip++;                                                 \
+        CHECK_NAN_EXCEPTION();                                \
+    } while (0)
+
+// generic arithmetic instruction that gets quickened for the operand types it sees (see 'Code::quicken')
+#define QUICKENING_BINARY_OP(op)                                              \
+    do {                                                                      \
+        CHECK_UNDERFLOW(2);                                                   \
+                                                                              \
+        if (code.can_quicken(ip))                                             \
+            code.quicken(ip, stack[sp-2].get_type(), stack[sp-1].get_type()); \
+        BINARY_OP(op);                                                        \
+    } while (0)
+
+// quickened instructions, go back to the generic instruction (and run it) when the types do not match
+// the ints are added/subtracted/multiplied on the raw 48 bits (the same as doing it on the values and truncating the result)
+#define QUICK_INT_OP(op)                                                                     \
+    do {                                                                                     \
+        CHECK_UNDERFLOW(2);                                                                  \
+                                                                                             \
+        if (!Box::both_int(stack[sp-2], stack[sp-1])) {                                      \
+            code.dequicken(ip);                                                              \
+            DISPATCH();                                                                      \
+        }                                                                                    \
+                                                                                             \
+        stack[sp-2].box_int(static_cast<int64_t>(stack[sp-2].bits() op stack[sp-1].bits())); \
+        sp--;                                                                                \
+        ip++;                                                                                \
+    } while (0)
+
+#define QUICK_DOUBLE_OP(op)                                                         \
+    do {                                                                            \
+        CHECK_UNDERFLOW(2);                                                         \
+                                                                                    \
+        if (!Box::both_double(stack[sp-2], stack[sp-1])) {                          \
+            code.dequicken(ip);                                                     \
+            DISPATCH();                                                             \
+        }                                                                           \
+                                                                                    \
+        stack[sp-2].box_double(stack[sp-2].as_double() op stack[sp-1].as_double()); \
+        sp--;                                                                       \
+        ip++;                                                                       \
+    } while (0)
+
+// jump to 'target' from the branch instruction at 'from' (the last one of the current basic block)
+#define JUMP(from, target)                                     \
+    do {                                                       \
+        const uint64_t executed = (from) + 1 - block_start;    \
+        if (fuel < executed) {                                 \
+            fuel = 0;                                          \
+            RAISE(Exception_Type::EXCEPTION_OUT_OF_FUEL);      \
+        }                                                      \
+        fuel -= executed;                                      \
+        if (interrupted.load(std::memory_order_relaxed))       \
+            RAISE(Exception_Type::EXCEPTION_INTERRUPTED);      \
+                                                               \
+        ip = (target);                                         \
+        block_start = ip;                                      \
+    } while (0)
+
+// stack bounds checks (only done when the program could not be verified, see 'Verifier')
+#define CHECK_UNDERFLOW(count)                                    \
+    do {                                                          \
+        if constexpr (checked) {                                  \
+            if (sp < (count))                                     \
+                RAISE(Exception_Type::EXCEPTION_STACK_UNDERFLOW); \
+        }                                                         \
+    } while (0)
+
+// compared even with the guard page, so the overflow leaves the loop like any other exception (and the output is synced),
+// the guard page only stops a push that the verifier wrongly proved safe
+#define CHECK_OVERFLOW()                                          \
+    do {                                                          \
+        if constexpr (checked) {                                  \
+            if (sp >= stack_cap)                                  \
+                RAISE(Exception_Type::EXCEPTION_STACK_OVERFLOW);  \
+        }                                                         \
+    } while (0)
+
+// used by all the instructions that take an index (relative to the top of the stack) as argument
+// (negative indices were already turned into traps by the decoder)
+#define CHECK_STACK_OFFSET(offset) CHECK_UNDERFLOW(offset)
+
+template <typename Box>
+Exception_Type Basic_Vm<Box>::run_threaded() {
+    // the verifier proved that no stack bounds check can fail (the arguments are below the stack of the program, and so is
+    // the stack of a snapshot, which has the arguments of the run that saved it)
+    const size_t base = (snapshot ? snapshot->stack.size() : 0) + arguments.size();
+    if (image->verification.verified && image->verification.max_stack_height + base < stack_cap)
+        return run_loop<false>();
+
+    return run_loop<true>();
+}
+
+template <typename Box>
+template <bool checked>
+Exception_Type Basic_Vm<Box>::run_loop() {
+    // local copies of the vm state (these shadow the members on purpose)
+    const uint8_t *const ops = code.ops.data();
+    const int64_t *const operands = code.operands.data();
+    Box *const stack = this->stack;
+    size_t sp = this->sp;
+    uint64_t ip = this->ip;
+    uint64_t fuel = this->fuel;
+    uint64_t block_start = ip;
+
+#ifdef USE_COMPUTED_GOTO
+    // must be in the same order as 'Inst_Type'
+    static const void *const dispatch_table[] = {
+        &&L_INST_NOP,
+        &&L_INST_EXIT,
+        &&L_INST_PUSH,
+        &&L_INST_POP,
+        &&L_INST_SWAP,
+        &&L_INST_DUP,
+        &&L_INST_PRINT,
+        &&L_INST_TD,
+        &&L_INST_TI,
+        &&L_INST_TP,
+        &&L_INST_ADD,
+        &&L_INST_SUB,
+        &&L_INST_MUL,
+        &&L_INST_DIV,
+        &&L_INST_MOD,
+        &&L_INST_AND,
+        &&L_INST_OR,
+        &&L_INST_XOR,
+        &&L_INST_NOT,
+        &&L_INST_NATIVE,
+        &&L_INST_SHL,
+        &&L_INST_SHR,
+        &&L_INST_SAR,
+        &&L_INST_JMP,
+        &&L_INST_EQU,
+        &&L_INST_JMP_IF,
+        &&L_INST_CALL,
+        &&L_INST_RET,
+        &&L_INST_READ,
+        &&L_INST_WRITE,
+        &&L_INST_READF,
+        &&L_INST_WRITEF,
+        &&L_INST_COPY,
+        &&L_INST_FILL,
+        &&L_INST_COMPARE,
+        &&L_INST_VADD,
+        &&L_INST_VSUB,
+        &&L_INST_VMUL,
+        &&L_INST_VDIV,
+        &&L_INST_VFMA,
+        &&L_INST_VSCALE,
+        &&L_INST_VDOT,
+        &&L_INST_VSUM,
+        &&L_INST_VMIN,
+        &&L_INST_VMAX,
+        &&L_INST_SPAWN,
+        &&L_INST_YIELD,
+        &&L_INST_JOIN,
+        &&L_INST_SLEEP,
+        &&L_INST_DUMP_STACK,
+        &&L_INST_DUMP_MEMORY,
+        &&L_INST_HALT,
+        &&L_OP_TRAP,
+        &&L_OP_SWAP_POP,
+        &&L_OP_PUSH_ADD,
+        &&L_OP_DUP_ADD,
+        &&L_OP_DUP_DUP,
+        &&L_OP_PUSH_EQU_JIF,
+        &&L_OP_ADD_II,
+        &&L_OP_ADD_DD,
+        &&L_OP_SUB_II,
+        &&L_OP_SUB_DD,
+        &&L_OP_MUL_II,
+        &&L_OP_MUL_DD,
+        &&L_OP_DIV_DD
+    };
+    static_assert(sizeof(dispatch_table) / sizeof(dispatch_table[0]) == static_cast<size_t>(Internal_Op::OP_COUNT));
+
+    DISPATCH();
+#else
+dispatch:
+    switch (ops[ip]) {
+#endif
+
+    INST_CASE(INST_NOP)
+        ip++;
+        DISPATCH();
+
+    INST_CASE(INST_HALT)
+        // stays in the same instruction (a loop, so it still uses fuel and can be interrupted)
+        JUMP(ip, ip);
+        DISPATCH();
+
+    INST_CASE(INST_EXIT)
+        // the entry function of a coroutine returns to the end of the code (the 'exit' appended there)
+        if (ip == code.end_addr() && current_coroutine != 0) {
+            JUMP(ip, ip);
+            this->ip = ip;
+            this->sp = sp;
+            if (const Exception_Type exception = end_of_code(); exception != Exception_Type::EXCEPTION_OK)
+                RAISE(exception);
+
+            ip = this->ip;
+            sp = this->sp;
+            block_start = ip;
+            DISPATCH();
+        }
+
+        RAISE(Exception_Type::EXCEPTION_EXIT);
+
+    INST_CASE(INST_PUSH)
+        CHECK_OVERFLOW();
+
+        stack[sp] = std::bit_cast<Box>(operands[ip]);
+        sp++;
+        ip++;
+        DISPATCH();
+
+    INST_CASE(INST_POP)
+        CHECK_UNDERFLOW(1);
+
+        sp--;
+        ip++;
+        DISPATCH();
+
+    INST_CASE(INST_ADD)
+        QUICKENING_BINARY_OP(+=);
+        DISPATCH();
+
+    INST_CASE(INST_SUB)
+        QUICKENING_BINARY_OP(-=);
+        DISPATCH();
+
+    INST_CASE(INST_MUL)
+        QUICKENING_BINARY_OP(*=);
+        DISPATCH();
+
+    INST_CASE(INST_DIV)
+        QUICKENING_BINARY_OP(/=);
+        DISPATCH();
+
+    INST_CASE(INST_MOD)
+        BINARY_OP(%=);
+        DISPATCH();
+
+    INST_CASE(INST_SHL)
+        BINARY_OP(<<=);
+        DISPATCH();
+
+    INST_CASE(INST_SAR)
+        BINARY_OP(>>=);
+        DISPATCH();
+
+    INST_CASE(INST_AND)
+        BINARY_OP(&=);
+        DISPATCH();
+
+    INST_CASE(INST_OR)
+        BINARY_OP(|=);
+        DISPATCH();
+
+    INST_CASE(INST_XOR)
+        BINARY_OP(^=);
+        DISPATCH();
+
+    INST_CASE(INST_SHR) {
+        CHECK_UNDERFLOW(2);
+
+        if (stack[sp-2].get_type() != Nan_Type::INT || stack[sp-1].get_type() != Nan_Type::INT)
+            RAISE(Exception_Type::EXCEPTION_BITWISE_NON_INT);
+
+        const int64_t num = stack[sp-2].as_int();
+        const int64_t shift_amt = stack[sp-1].as_int();
+        stack[sp-2].box_int((num >> shift_amt) & ((1LL << (48LL - shift_amt)) - 1));
+        sp--;
+        ip++;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_NOT)
+        CHECK_UNDERFLOW(1);
+
+        stack[sp-1] = ~stack[sp-1];
+        ip++;
+        CHECK_NAN_EXCEPTION();
+        DISPATCH();
+
+    INST_CASE(INST_EQU)
+        CHECK_UNDERFLOW(2);
+
+        stack[sp-2].box_int(stack[sp-2] == stack[sp-1]);
+        sp--;
+        ip++;
+        DISPATCH();
+
+    INST_CASE(INST_JMP)
+        JUMP(ip, static_cast<uint64_t>(operands[ip]));
+        DISPATCH();
+
+    INST_CASE(INST_JMP_IF)
+        CHECK_UNDERFLOW(1);
+
+        sp--;
+        // the not taken branch just keeps going in the same basic block
+        if (stack[sp] != Box(static_cast<int64_t>(0)))
+            JUMP(ip, static_cast<uint64_t>(operands[ip]));
+        else
+            ip++;
+        DISPATCH();
+
+    INST_CASE(INST_CALL)
+        CHECK_OVERFLOW();
+
+        stack[sp] = Box((void*)(ip+1));
+        sp++;
+        JUMP(ip, static_cast<uint64_t>(operands[ip]));
+        DISPATCH();
+
+    INST_CASE(INST_RET)
+        CHECK_UNDERFLOW(1);
+
+        if (stack[sp-1].get_type() != Nan_Type::PTR)
+            RAISE(Exception_Type::EXCEPTION_INVALID_RET_ADDR);
+
+        // returning to an addr outside of the program ends it
+        sp--;
+        JUMP(ip, std::min((uint64_t)stack[sp].as_ptr(), code.end_addr()));
+        DISPATCH();
+
+    INST_CASE(INST_DUP) {
+        const size_t offset = static_cast<size_t>(operands[ip]);
+        CHECK_OVERFLOW();
+
+        CHECK_STACK_OFFSET(offset);
+
+        stack[sp] = stack[sp-offset];
+        sp++;
+        ip++;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_SWAP) {
+        const size_t offset = static_cast<size_t>(operands[ip]);
+        CHECK_OVERFLOW();
+
+        CHECK_STACK_OFFSET(offset);
+
+        std::swap(stack[sp-1], stack[sp-offset]);
+        ip++;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_PRINT) {
+        const size_t offset = static_cast<size_t>(operands[ip]);
+        CHECK_STACK_OFFSET(offset);
+
+        print_value(stack[sp-offset]);
+        ip++;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_TD) {
+        const size_t offset = static_cast<size_t>(operands[ip]);
+        CHECK_STACK_OFFSET(offset);
+
+        cast_to_double(stack[sp-offset]);
+        ip++;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_TI) {
+        const size_t offset = static_cast<size_t>(operands[ip]);
+        CHECK_STACK_OFFSET(offset);
+
+        cast_to_int(stack[sp-offset]);
+        ip++;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_TP) {
+        const size_t offset = static_cast<size_t>(operands[ip]);
+        CHECK_STACK_OFFSET(offset);
+
+        cast_to_ptr(stack[sp-offset]);
+        ip++;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_READ)
+    INST_CASE(INST_WRITE)
+    INST_CASE(INST_READF)
+    INST_CASE(INST_WRITEF)
+    INST_CASE(INST_COPY)
+    INST_CASE(INST_FILL)
+    INST_CASE(INST_COMPARE)
+    INST_CASE(INST_VADD)
+    INST_CASE(INST_VSUB)
+    INST_CASE(INST_VMUL)
+    INST_CASE(INST_VDIV)
+    INST_CASE(INST_VFMA)
+    INST_CASE(INST_VSCALE)
+    INST_CASE(INST_VDOT)
+    INST_CASE(INST_VSUM)
+    INST_CASE(INST_VMIN)
+    INST_CASE(INST_VMAX) {
+        // not worth duplicating (dominated by the memory checks)
+        this->ip = ip;
+        this->sp = sp;
+        const Exception_Type exception = execute_instruction(image->insts[ip]);
+        if (exception != Exception_Type::EXCEPTION_OK)
+            RAISE(exception);
+
+        ip = this->ip;
+        sp = this->sp;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_SPAWN)
+    INST_CASE(INST_YIELD)
+    INST_CASE(INST_JOIN)
+    INST_CASE(INST_SLEEP) {
+        // switching to another coroutine changes the control flow (and the values on the stack)
+        JUMP(ip, ip);
+        this->ip = ip;
+        this->sp = sp;
+        const Exception_Type exception = execute_instruction(image->insts[ip]);
+        if (exception != Exception_Type::EXCEPTION_OK)
+            RAISE(exception);
+
+        ip = this->ip;
+        sp = this->sp;
+        block_start = ip;
+        DISPATCH();
+    }
+
+    INST_CASE(INST_NATIVE)
+        // we assume that all the native functions return exactly one value
+        CHECK_UNDERFLOW(1);
+
+        // the native functions work on the vm state
+        this->ip = ip;
+        this->sp = sp;
+        if (const Exception_Type exception = (this->*native_funcs_addrs[static_cast<size_t>(operands[ip])])(); exception != Exception_Type::EXCEPTION_OK)
+            RAISE(exception);
+        sp = this->sp;
+        ip++;
+        DISPATCH();
+
+    INST_CASE(INST_DUMP_STACK)
+        this->sp = sp;
+        dump_stack();
+        ip++;
+        DISPATCH();
+
+    INST_CASE(INST_DUMP_MEMORY)
+        dump_memory();
+        ip++;
+        DISPATCH();
+
+    INST_CASE(OP_TRAP)
+        RAISE(static_cast<Exception_Type>(operands[ip]));
+
+    // superinstructions (they do the same checks, in the same order, as the instructions they replace)
+
+    INST_CASE(OP_SWAP_POP) {
+        const size_t offset = static_cast<size_t>(operands[ip]);
+        CHECK_OVERFLOW();
+
+        CHECK_STACK_OFFSET(offset);
+
+        stack[sp-offset] = stack[sp-1];
+        sp--;
+        ip += 2;
+        DISPATCH();
+    }
+
+    INST_CASE(OP_PUSH_ADD) {
+        CHECK_OVERFLOW();
+
+        CHECK_UNDERFLOW(1);
+
+        Box value = std::bit_cast<Box>(operands[ip]);
+        stack[sp-1] += value;
+        ip += 2;
+        CHECK_NAN_EXCEPTION();
+        DISPATCH();
+    }
+
+    INST_CASE(OP_DUP_ADD) {
+        const size_t offset = static_cast<size_t>(operands[ip]);
+        CHECK_OVERFLOW();
+
+        CHECK_STACK_OFFSET(offset);
+
+        Box value = stack[sp-offset];
+        stack[sp-1] += value;
+        ip += 2;
+        CHECK_NAN_EXCEPTION();
+        DISPATCH();
+    }
+
+    INST_CASE(OP_DUP_DUP) {
+        const size_t offset_a = static_cast<size_t>(operands[ip]);
+        const size_t offset_b = static_cast<size_t>(operands[ip+1]);
+        CHECK_OVERFLOW();
+
+        CHECK_STACK_OFFSET(offset_a);
+
+        stack[sp] = stack[sp-offset_a];
+        sp++;
+        ip++;
+
+        CHECK_OVERFLOW();
+
+        CHECK_STACK_OFFSET(offset_b);
+
+        stack[sp] = stack[sp-offset_b];
+        sp++;
+        ip++;
+        DISPATCH();
+    }
+
+    INST_CASE(OP_PUSH_EQU_JIF) {
+        CHECK_OVERFLOW();
+
+        CHECK_UNDERFLOW(1);
+
+        Box value = std::bit_cast<Box>(operands[ip]);
+        const bool equal = stack[sp-1] == value;
+        sp--;
+        if (equal)
+            JUMP(ip + 2, static_cast<uint64_t>(operands[ip+2]));
+        else
+            ip += 3;
+        DISPATCH();
+    }
+
+    INST_CASE(OP_ADD_II)
+        QUICK_INT_OP(+);
+        DISPATCH();
+
+    INST_CASE(OP_ADD_DD)
+        QUICK_DOUBLE_OP(+);
+        DISPATCH();
+
+    INST_CASE(OP_SUB_II)
+        QUICK_INT_OP(-);
+        DISPATCH();
+
+    INST_CASE(OP_SUB_DD)
+        QUICK_DOUBLE_OP(-);
+        DISPATCH();
+
+    INST_CASE(OP_MUL_II)
+        QUICK_INT_OP(*);
+        DISPATCH();
+
+    INST_CASE(OP_MUL_DD)
+        QUICK_DOUBLE_OP(*);
+        DISPATCH();
+
+    INST_CASE(OP_DIV_DD)
+        CHECK_UNDERFLOW(2);
+
+        // division by 0 raises an exception in the generic instruction
+        if (stack[sp-1].as_double() == 0.0) {
+            code.dequicken(ip);
+            DISPATCH();
+        }
+
+        QUICK_DOUBLE_OP(/);
+        DISPATCH();
+
+#ifndef USE_COMPUTED_GOTO
+    default:
+        RAISE(Exception_Type::EXCEPTION_UNKNOWN_INSTRUCTION);
+    }
+#endif
+}
+
+template Exception_Type Basic_Vm<Nan_Box>::run_threaded();
+template Exception_Type Basic_Vm<Int_Box>::run_threaded();
@@ -1,12 +1,183 @@
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <cstring>
+#include <charconv>
+#include <thread>
+#include <new>
 
 #include "vm.h"
+#include "batch.h"
 #include "program_args.h"
 
 void program_usage(const char* program_name) {
     std::cerr << "Usage: " << program_name << " [args]" << std::endl;
     std::cerr << "    args: -i: Input file name to run." << std::endl;
+    std::cerr << "          -d: Interpreter loop to use, 'threaded' (default) or 'switch'." << std::endl;
+    std::cerr << "          -n: Do not replace common instruction sequences with superinstructions." << std::endl;
+    std::cerr << "          -v: Print the result of the stack verification (and the max stack height of each function) to stderr." << std::endl;
+    std::cerr << "          -s: Max number of values in the stack (default: " << DEFAULT_STACK_CAP << ", rounded up to fill a memory page)." << std::endl;
+    std::cerr << "          -r: Value representation, 'nan' (default, favors doubles) or 'int' (favors ints)." << std::endl;
+    std::cerr << "          -f: Max number of instructions to execute (default: unlimited)." << std::endl;
+    std::cerr << "          -t: Max execution time in milliseconds (default: unlimited)." << std::endl;
+    std::cerr << "          -p: Profile the program and print the most frequent instruction sequences to stderr." << std::endl;
+    std::cerr << "          -m: Print the heap (malloc/free natives) statistics to stderr." << std::endl;
+    std::cerr << "          -b: When the output is written, 'line', 'size' or 'exit' (default: 'line' for terminals, 'size' otherwise)." << std::endl;
+    std::cerr << "          -w: Write the output from a background thread." << std::endl;
+    std::cerr << "          -B: Batch mode, runs the program once per line of the given file ('-' for stdin), the line is the stdin of the run." << std::endl;
+    std::cerr << "              The output of each run is written in the order of the lines, -f, -t and -s apply to each run." << std::endl;
+    std::cerr << "          -j: Number of worker threads for the batch mode (default: number of cores)." << std::endl;
+    std::cerr << "          -S: Save the state of the vm to the given file at the 'snapshot' native (and stop there)." << std::endl;
+    std::cerr << "          -R: Start from the state saved in the given file (with '-B', every run starts from it)." << std::endl;
+}
+
+// parses the value of a numeric option (exits if it is not a positive number)
+uint64_t get_number_option(const std::vector<std::string_view>& args, const char* option_name) {
+    const std::string_view value_str = program_args::get_option(args, option_name);
+    uint64_t value = 0;
+
+    const auto [end, ec] = std::from_chars(value_str.data(), value_str.data() + value_str.size(), value);
+    if (ec != std::errc() || end != value_str.data() + value_str.size() || value == 0) {
+        std::cerr << "ERROR: Option '" << option_name << "' requires a positive number as parameter." << std::endl;
+        program_usage(args.at(0).data());
+        exit(1);
+    }
+
+    return value;
+}
+
+// parses the value of a path option (exits if it is empty)
+std::string_view get_path_option(const std::vector<std::string_view>& args, const char* option_name) {
+    const std::string_view path = program_args::get_option(args, option_name);
+    if (path == "") {
+        std::cerr << "ERROR: Option '" << option_name << "' requires a parameter." << std::endl;
+        program_usage(args.at(0).data());
+        exit(1);
+    }
+
+    return path;
+}
+
+// execution limits and snapshots of a vm
+template <typename Box>
+void set_limits(Basic_Vm<Box> &vm, const std::vector<std::string_view>& args, const std::shared_ptr<const Snapshot> &snapshot) {
+    if (program_args::has_option(args, "-f"))
+        vm.set_fuel(get_number_option(args, "-f"));
+    if (program_args::has_option(args, "-t"))
+        vm.set_timeout(std::chrono::milliseconds(get_number_option(args, "-t")));
+    if (program_args::has_option(args, "-S"))
+        vm.set_snapshot_output(std::string(get_path_option(args, "-S")));
+
+    if (snapshot && !vm.set_snapshot(snapshot)) {
+        std::cerr << "ERROR: The snapshot was not taken with this program (or its stack does not fit, see '-s')." << std::endl;
+        exit(1);
+    }
+}
+
+// runs the program once per line of the batch file (see 'Batch'), exits with 1 if any run raised an exception
+template <typename Box>
+void run_batch(const std::shared_ptr<const Image> &image, const std::shared_ptr<const Snapshot> &snapshot, const std::vector<std::string_view>& args, const Dispatch_Mode mode, const size_t stack_cap) {
+    const std::string_view batch_path = program_args::get_option(args, "-B");
+    if (batch_path == "") {
+        std::cerr << "ERROR: Option '-B' requires a parameter." << std::endl;
+        program_usage(args.at(0).data());
+        exit(1);
+    }
+
+    if (mode == Dispatch_Mode::PROFILE) {
+        std::cerr << "ERROR: Option '-p' cannot be used with '-B'." << std::endl;
+        program_usage(args.at(0).data());
+        exit(1);
+    }
+
+    if (program_args::has_option(args, "-S")) {
+        std::cerr << "ERROR: Option '-S' cannot be used with '-B'." << std::endl;
+        program_usage(args.at(0).data());
+        exit(1);
+    }
+
+    // read all the records (one per line)
+    std::string data;
+    if (batch_path == "-") {
+        data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    } else {
+        std::ifstream file(batch_path.data(), std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "ERROR: An error occured when trying to read the batch file '" << batch_path << "'" << std::endl;
+            exit(1);
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    std::vector<std::string_view> records;
+    for (size_t begin = 0; begin < data.size();) {
+        const size_t end = std::min(data.find('\n', begin), data.size());
+        records.push_back(std::string_view(data).substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    const size_t workers = program_args::has_option(args, "-j") ? get_number_option(args, "-j") : std::thread::hardware_concurrency();
+
+    Output out(1);
+    Output err(2);
+    Batch<Box> batch(image, workers, stack_cap, mode, [&args, &snapshot](Basic_Vm<Box> &vm) { set_limits(vm, args, snapshot); });
+    const size_t failed = batch.run(records, [&out, &err](const size_t record, const Batch_Result &result) {
+        out.write(result.out.data(), result.out.size());
+        err.write(result.err.data(), result.err.size());
+
+        if (result.exception != Exception_Type::EXCEPTION_OK) {
+            const std::string message = "ERROR: Record " + std::to_string(record + 1) + ": Exception occured '" + exception_as_cstr(result.exception) + "'\n";
+            err.write(message.data(), message.size());
+        }
+    });
+
+    out.sync();
+    err.sync();
+    if (failed > 0)
+        exit(1);
+}
+
+// runs the program with the value representation 'Box'
+template <typename Box>
+void run(const std::shared_ptr<const Image> &image, const std::shared_ptr<const Snapshot> &snapshot, const std::vector<std::string_view>& args, const Dispatch_Mode mode, const size_t stack_cap) {
+    Basic_Vm<Box> vm(image, stack_cap);
+
+    if (program_args::has_option(args, "-v")) {
+        const Verification &v = image->verification;
+        if (v.verified) {
+            std::cerr << "Stack verified, max stack height: " << v.max_stack_height << " (stack capacity: " << vm.get_stack_cap() << ")" << std::endl;
+            for (const Function_Info &func: v.functions)
+                std::cerr << "    function at addr " << func.entry << ": max stack height " << func.max_height << std::endl;
+        } else {
+            std::cerr << "Could not verify the stack (" << v.error << "), running with stack checks." << std::endl;
+        }
+    }
+
+    set_limits(vm, args, snapshot);
+
+    if (program_args::has_option(args, "-b")) {
+        const std::string_view policy = program_args::get_option(args, "-b");
+        if (policy == "line") {
+            vm.get_output().set_policy(Flush_Policy::LINE);
+        } else if (policy == "size") {
+            vm.get_output().set_policy(Flush_Policy::SIZE);
+        } else if (policy == "exit") {
+            vm.get_output().set_policy(Flush_Policy::EXIT);
+        } else {
+            std::cerr << "ERROR: Option '-b' requires 'line', 'size' or 'exit' as parameter." << std::endl;
+            program_usage(args.at(0).data());
+            exit(1);
+        }
+    }
+    if (program_args::has_option(args, "-w"))
+        vm.get_output().set_background(true);
+
+    vm.execute_program(false, mode);
+
+    if (mode == Dispatch_Mode::PROFILE)
+        vm.dump_profile(std::cerr);
+    if (program_args::has_option(args, "-m"))
+        vm.get_heap().dump_stats(std::cerr);
 }
 
 int main(int argc, char* argv[]) {
@@ -25,10 +196,68 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
-    Program p;
-    p.read_from_file(input_file_path.data());
+    Dispatch_Mode mode = Dispatch_Mode::THREADED;
+    if (program_args::has_option(args, "-d")) {
+        const std::string_view dispatch_mode = program_args::get_option(args, "-d");
+        if (dispatch_mode == "switch") {
+            mode = Dispatch_Mode::SWITCH;
+        } else if (dispatch_mode != "threaded") {
+            std::cerr << "ERROR: Option '-d' requires 'threaded' or 'switch' as parameter." << std::endl;
+            program_usage(args.at(0).data());
+            exit(1);
+        }
+    }
+
+    const size_t stack_cap = program_args::has_option(args, "-s") ? get_number_option(args, "-s") : DEFAULT_STACK_CAP;
+
+    if (program_args::has_option(args, "-p"))
+        mode = Dispatch_Mode::PROFILE;
+
+    std::string_view representation = "nan";
+    if (program_args::has_option(args, "-r")) {
+        representation = program_args::get_option(args, "-r");
+        if (representation != "nan" && representation != "int") {
+            std::cerr << "ERROR: Option '-r' requires 'nan' or 'int' as parameter." << std::endl;
+            program_usage(args.at(0).data());
+            exit(1);
+        }
+    }
+
+    std::string error;
+    const std::shared_ptr<const Image> image = Image::load(input_file_path.data(), error, !program_args::has_option(args, "-n"));
+    if (!image) {
+        std::cerr << "ERROR: " << error << "." << std::endl;
+        exit(1);
+    }
+
+    // shared by all the vms (mapped once)
+    std::shared_ptr<const Snapshot> snapshot;
+    if (program_args::has_option(args, "-R")) {
+        snapshot = Snapshot::load(get_path_option(args, "-R").data(), error);
+        if (!snapshot) {
+            std::cerr << "ERROR: " << error << "." << std::endl;
+            exit(1);
+        }
+    }
+
+    // a push past the end of the stack (only possible if the verification was wrong) is reported as a stack overflow
+    Memory_Region::catch_guard_page_faults();
+
+    try {
+        if (program_args::has_option(args, "-B")) {
+            if (representation == "int")
+                run_batch<Int_Box>(image, snapshot, args, mode, stack_cap);
+            else
+                run_batch<Nan_Box>(image, snapshot, args, mode, stack_cap);
+        } else if (representation == "int") {
+            run<Int_Box>(image, snapshot, args, mode, stack_cap);
+        } else {
+            run<Nan_Box>(image, snapshot, args, mode, stack_cap);
+        }
+    } catch (const std::bad_alloc &) {
+        std::cerr << "ERROR: Could not reserve the memory of the vm." << std::endl;
+        exit(1);
+    }
 
-    Vm vm(p);
-    vm.execute_program();
     return 0;
 }
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libvm.h"
+
+/*
+ Checks the C API of libvm (built as C and linked with the shared library) with 'libvm.vasm':
+ the program is loaded from memory (and from the file) and one vm is run many times with different arguments.
+ */
+
+#define CHECK(condition)                                                                       \
+    do {                                                                                       \
+        if (!(condition)) {                                                                    \
+            fprintf(stderr, "ERROR: %s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            return 1;                                                                          \
+        }                                                                                      \
+    } while (0)
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file.vm>\n", argv[0]);
+        return 1;
+    }
+
+    // read the whole '.vm' file
+    FILE *file = fopen(argv[1], "rb");
+    CHECK(file != NULL);
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc((size_t)size);
+    CHECK(data != NULL && fread(data, 1, (size_t)size, file) == (size_t)size);
+    fclose(file);
+
+    CHECK(vm_image_load("not a program", 13) == NULL);
+    CHECK(vm_image_load_file("does_not_exist.vm") == NULL);
+    vm_image *mapped = vm_image_load_file(argv[1]);
+    CHECK(mapped != NULL);
+    vm_image_free(mapped);
+
+    vm_image *image = vm_image_load(data, (size_t)size);
+    CHECK(image != NULL);
+
+    // the vm keeps the image alive
+    vm_instance *vm = vm_create(image, 0);
+    CHECK(vm != NULL);
+    vm_image_free(image);
+    free(data);
+
+    // the same vm is reused for every call
+    vm_capture_output(vm, 1);
+    for (int64_t i = 0; i < 1000; i++) {
+        vm_clear_arguments(vm);
+        vm_push_int(vm, i);
+        vm_push_int(vm, 3);
+        CHECK(vm_run(vm) == VM_OK);
+        CHECK(vm_result_count(vm) == 1);
+        CHECK(vm_result_type(vm, 0) == VM_VALUE_INT);
+        CHECK(vm_result_int(vm, 0) == i * 3 + i);
+    }
+
+    size_t output_size;
+    const char *output = vm_output(vm, &output_size);
+    CHECK(output_size == 3000 && memcmp(output, "ok\nok\n", 6) == 0);
+    vm_clear_output(vm);
+
+    vm_clear_arguments(vm);
+    vm_push_double(vm, 1.5);
+    vm_push_double(vm, 2.0);
+    CHECK(vm_run(vm) == VM_OK);
+    CHECK(vm_result_type(vm, 0) == VM_VALUE_DOUBLE && vm_result_double(vm, 0) == 4.5);
+
+    size_t memory_size;
+    CHECK(vm_memory(vm, &memory_size) != NULL && memory_size >= 3);
+
+    // without the arguments the program raises an exception (and the process goes on)
+    vm_clear_arguments(vm);
+    const int exception = vm_run(vm);
+    CHECK(exception != VM_OK && strcmp(vm_exception_name(exception), "EXCEPTION_STACK_UNDERFLOW") == 0);
+
+    vm_destroy(vm);
+    printf("libvm ok\n");
+    return 0;
+}